@@ -0,0 +1,362 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <chrono>
+#include "mmu.h"
+#include "pagetable.h"
+#include "simulator.h"
+
+#define BENCH_MEMORY_SIZE 67108864
+#define BENCH_PAGES_PER_PROCESS 256
+#define BENCH_TRANSLATIONS 4096
+
+// Parameters of one benchmark case; unused ones are left at zero
+typedef struct BenchParams {
+    int page_size;
+    int processes;
+    int variables;
+} BenchParams;
+
+// Handed to each benchmark run. Only the time between startTiming() and
+// stopTiming() counts, so setup and teardown stay out of the measurement.
+class BenchState {
+private:
+    std::chrono::steady_clock::time_point _start;
+    double _elapsed;
+    uint64_t _operations;
+
+public:
+    BenchParams params;
+
+    BenchState(BenchParams p) : _elapsed(0), _operations(0), params(p) {}
+
+    void startTiming() { _start = std::chrono::steady_clock::now(); }
+    void stopTiming(uint64_t operations)
+    {
+        std::chrono::duration<double> span = std::chrono::steady_clock::now() - _start;
+        _elapsed += span.count();
+        _operations += operations;
+    }
+
+    double elapsed() { return _elapsed; }
+    uint64_t operations() { return _operations; }
+};
+
+typedef void (*BenchFunction)(BenchState &state);
+
+typedef struct Benchmark {
+    std::string name;
+    BenchFunction function;
+    BenchParams params;
+} Benchmark;
+
+typedef struct BenchResult {
+    std::string name;
+    BenchParams params;
+    uint64_t operations;
+    double seconds;
+} BenchResult;
+
+// Simulator output is discarded while benchmarking
+static std::ostream null_stream(NULL);
+
+static std::vector<std::string> variableNames(int count)
+{
+    std::vector<std::string> names;
+    for (int i = 0; i < count; i++)
+    {
+        names.push_back("v" + std::to_string(i));
+    }
+    return names;
+}
+
+static uint32_t nextRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void benchAddEntry(BenchState &state)
+{
+    BenchParams p = state.params;
+    PageTable page_table(p.page_size, BENCH_MEMORY_SIZE);
+    int pages = std::min(BENCH_PAGES_PER_PROCESS, BENCH_MEMORY_SIZE / p.page_size / p.processes);
+
+    state.startTiming();
+    for (int i = 0; i < p.processes; i++)
+    {
+        for (int page = 0; page < pages; page++)
+        {
+            page_table.addEntry(PID_BASE + i, page);
+        }
+    }
+    state.stopTiming((uint64_t)p.processes * pages);
+}
+
+static void benchGetPhysicalAddress(BenchState &state)
+{
+    BenchParams p = state.params;
+    PageTable page_table(p.page_size, BENCH_MEMORY_SIZE);
+    int pages = std::min(BENCH_PAGES_PER_PROCESS, BENCH_MEMORY_SIZE / p.page_size / p.processes);
+    for (int i = 0; i < p.processes; i++)
+    {
+        for (int page = 0; page < pages; page++)
+        {
+            page_table.addEntry(PID_BASE + i, page);
+        }
+    }
+
+    // Translations hop between processes the way interleaved commands do
+    uint32_t seed = 2463534242u;
+    std::vector<uint32_t> pids(BENCH_TRANSLATIONS);
+    std::vector<uint32_t> addresses(BENCH_TRANSLATIONS);
+    for (int i = 0; i < BENCH_TRANSLATIONS; i++)
+    {
+        pids[i] = PID_BASE + nextRandom(&seed) % p.processes;
+        addresses[i] = nextRandom(&seed) % ((uint32_t)pages * p.page_size);
+    }
+
+    int checksum = 0;
+    state.startTiming();
+    for (int i = 0; i < BENCH_TRANSLATIONS; i++)
+    {
+        checksum += page_table.getPhysicalAddress(pids[i], addresses[i]);
+    }
+    state.stopTiming(BENCH_TRANSLATIONS);
+    null_stream << checksum;
+}
+
+// Creates the processes for a case and returns their PIDs
+static std::vector<uint32_t> createProcesses(Mmu *mmu, PageTable *page_table, BenchParams p)
+{
+    std::vector<uint32_t> pids;
+    for (int i = 0; i < p.processes; i++)
+    {
+        createProcess(1024, 1024, mmu, page_table, p.page_size);
+        pids.push_back(PID_BASE + i);
+    }
+    return pids;
+}
+
+static void allocateAll(std::vector<uint32_t> &pids, std::vector<std::string> &names, Mmu *mmu, PageTable *page_table, int page_size)
+{
+    for (int i = 0; i < pids.size(); i++)
+    {
+        for (int j = 0; j < names.size(); j++)
+        {
+            allocateVariable(pids[i], names[j], Int, 16 + (j % 7) * 8, mmu, page_table, page_size);
+        }
+    }
+}
+
+static void terminateAll(std::vector<uint32_t> &pids, Mmu *mmu, PageTable *page_table, int page_size)
+{
+    for (int i = 0; i < pids.size(); i++)
+    {
+        terminateProcess(pids[i], mmu, page_table, page_size);
+    }
+}
+
+static void benchAllocateVariable(BenchState &state)
+{
+    BenchParams p = state.params;
+    Mmu mmu(BENCH_MEMORY_SIZE);
+    PageTable page_table(p.page_size, BENCH_MEMORY_SIZE);
+    std::vector<std::string> names = variableNames(p.variables);
+    std::vector<uint32_t> pids = createProcesses(&mmu, &page_table, p);
+
+    state.startTiming();
+    allocateAll(pids, names, &mmu, &page_table, p.page_size);
+    state.stopTiming((uint64_t)p.processes * p.variables);
+
+    terminateAll(pids, &mmu, &page_table, p.page_size);
+}
+
+static void benchFreeVariable(BenchState &state)
+{
+    BenchParams p = state.params;
+    Mmu mmu(BENCH_MEMORY_SIZE);
+    PageTable page_table(p.page_size, BENCH_MEMORY_SIZE);
+    std::vector<std::string> names = variableNames(p.variables);
+    std::vector<uint32_t> pids = createProcesses(&mmu, &page_table, p);
+    allocateAll(pids, names, &mmu, &page_table, p.page_size);
+
+    // Free every other variable first so the rest merge on both sides
+    state.startTiming();
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < pids.size(); i++)
+        {
+            for (int j = pass; j < names.size(); j += 2)
+            {
+                freeVariable(pids[i], names[j], &mmu, &page_table, p.page_size);
+            }
+        }
+    }
+    state.stopTiming((uint64_t)p.processes * p.variables);
+
+    terminateAll(pids, &mmu, &page_table, p.page_size);
+}
+
+static void benchTerminateProcess(BenchState &state)
+{
+    BenchParams p = state.params;
+    Mmu mmu(BENCH_MEMORY_SIZE);
+    PageTable page_table(p.page_size, BENCH_MEMORY_SIZE);
+    std::vector<std::string> names = variableNames(p.variables);
+    std::vector<uint32_t> pids = createProcesses(&mmu, &page_table, p);
+    allocateAll(pids, names, &mmu, &page_table, p.page_size);
+
+    state.startTiming();
+    terminateAll(pids, &mmu, &page_table, p.page_size);
+    state.stopTiming(p.processes);
+}
+
+static std::vector<Benchmark> registerBenchmarks()
+{
+    static const int page_sizes[] = {1024, 4096, 16384};
+    static const int process_counts[] = {1, 16, 256};
+    static const int variable_counts[] = {64, 1024};
+    std::vector<Benchmark> benchmarks;
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            BenchParams params = {page_sizes[i], process_counts[j], 0};
+            Benchmark add = {"PageTable::addEntry", benchAddEntry, params};
+            Benchmark translate = {"PageTable::getPhysicalAddress", benchGetPhysicalAddress, params};
+            benchmarks.push_back(add);
+            benchmarks.push_back(translate);
+        }
+    }
+
+    // Variable workloads keep every process's allocations well inside memory
+    static const BenchFunction variable_functions[] = {benchAllocateVariable, benchFreeVariable, benchTerminateProcess};
+    static const char *variable_names[] = {"allocateVariable", "freeVariable", "terminateProcess"};
+    for (int f = 0; f < 3; f++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 2; j++)
+            {
+                for (int k = 0; k < 2; k++)
+                {
+                    BenchParams params = {page_sizes[i], process_counts[j], variable_counts[k]};
+                    Benchmark benchmark = {variable_names[f], variable_functions[f], params};
+                    benchmarks.push_back(benchmark);
+                }
+            }
+        }
+    }
+    return benchmarks;
+}
+
+static std::string caseName(const Benchmark &benchmark)
+{
+    std::string name = benchmark.name + "/page_size:" + std::to_string(benchmark.params.page_size)
+                     + "/processes:" + std::to_string(benchmark.params.processes);
+    if (benchmark.params.variables > 0)
+    {
+        name += "/variables:" + std::to_string(benchmark.params.variables);
+    }
+    return name;
+}
+
+// Repeats a case until it has been timed for at least min_time seconds
+static BenchResult runBenchmark(const Benchmark &benchmark, double min_time)
+{
+    BenchState state(benchmark.params);
+    do
+    {
+        benchmark.function(state);
+    } while (state.elapsed() < min_time);
+
+    BenchResult result = {caseName(benchmark), benchmark.params, state.operations(), state.elapsed()};
+    return result;
+}
+
+static void printJson(std::vector<BenchResult> &results)
+{
+    std::cout << "{\n  \"benchmarks\": [\n";
+    for (int i = 0; i < results.size(); i++)
+    {
+        BenchResult &r = results[i];
+        std::cout << "    {\"name\": \"" << r.name << "\", \"page_size\": " << r.params.page_size
+                  << ", \"processes\": " << r.params.processes << ", \"variables\": " << r.params.variables
+                  << ", \"iterations\": " << r.operations << ", \"real_time\": " << r.seconds * 1e9 / r.operations
+                  << ", \"time_unit\": \"ns\", \"items_per_second\": " << r.operations / r.seconds << "}"
+                  << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    std::cout << "  ]\n}\n";
+}
+
+static void printCsv(std::vector<BenchResult> &results)
+{
+    std::cout << "name,page_size,processes,variables,iterations,ns_per_op,ops_per_sec\n";
+    for (int i = 0; i < results.size(); i++)
+    {
+        BenchResult &r = results[i];
+        std::cout << r.name << ',' << r.params.page_size << ',' << r.params.processes << ',' << r.params.variables << ','
+                  << r.operations << ',' << r.seconds * 1e9 / r.operations << ',' << r.operations / r.seconds << '\n';
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string format = "json";
+    std::string filter = "";
+    double min_time = 0.1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--format" && i + 1 < argc && (std::string(argv[i + 1]) == "json" || std::string(argv[i + 1]) == "csv"))
+        {
+            // --format <json|csv>
+            format = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--filter" && i + 1 < argc)
+        {
+            // --filter <text> runs only cases whose name contains text
+            filter = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--min-time" && i + 1 < argc)
+        {
+            // --min-time <seconds> sets how long each case is timed for
+            min_time = std::stod(argv[i + 1]);
+            i += 1;
+        }
+        else
+        {
+            fprintf(stderr, "Error: unrecognized option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    setSimOut(&null_stream);
+    std::vector<Benchmark> benchmarks = registerBenchmarks();
+    std::vector<BenchResult> results;
+    for (int i = 0; i < benchmarks.size(); i++)
+    {
+        if (caseName(benchmarks[i]).find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        results.push_back(runBenchmark(benchmarks[i], min_time));
+    }
+
+    if (format == "csv")
+    {
+        printCsv(results);
+    }
+    else
+    {
+        printJson(results);
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef __ACCESSTRACE_H_
+#define __ACCESSTRACE_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "simulator.h"
+
+// Bytes read from an access trace at a time; two chunks are in memory at once
+#define ACCESS_TRACE_CHUNK (4u << 20)
+
+// Reads a file, or standard input for "-", on a background thread into two
+// buffers, so the next chunk is read while the current one is processed
+class AccessTraceReader {
+private:
+    int _fd;
+    std::thread _thread;
+    std::mutex _lock;
+    std::condition_variable _changed;
+    std::vector<char> _buffers[2];
+    size_t _lengths[2];
+    bool _full[2];
+    bool _stopping;
+    bool _failed;
+    int _current; // buffer held by the consumer, -1 before the first
+
+    void readLoop();
+
+public:
+    AccessTraceReader();
+    ~AccessTraceReader();
+
+    bool open(std::string path);
+    bool failed();
+
+    // Hands out the next chunk and takes back the one handed out before it.
+    // Returns false at the end of the input.
+    bool next(const char **data, size_t *length);
+};
+
+// Replays a raw access trace with one access per line:
+//   <pid> <R|W> <virtual_address> <size>
+// The address is decimal or 0x-prefixed hex. Pages are mapped on first touch,
+// and every access is translated through the page table, TLB, swap and
+// caches, and fed to the working-set analyzer and page size sweep, as
+// configured. Trace pids name page tables directly; no MMU
+// processes are created. Returns the number of records run, or -1 if the
+// trace could not be read.
+long runAccessTrace(std::string path, Simulator *sim);
+
+#endif // __ACCESSTRACE_H_
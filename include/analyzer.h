@@ -0,0 +1,87 @@
+#ifndef __ANALYZER_H_
+#define __ANALYZER_H_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+// Reuse distance of a first access
+#define REUSE_COLD UINT64_MAX
+
+// Bucket 0 counts distance 0 and bucket b counts [2^(b-1), 2^b)
+#define REUSE_BUCKETS 33
+
+// Footprints are kept in 2^ANALYZER_BLOCK_BITS-byte blocks, so the footprint
+// at every power-of-two page size up to 2^ANALYZER_MAX_PAGE_BITS follows
+// from one run
+#define ANALYZER_BLOCK_BITS 8
+#define ANALYZER_MAX_PAGE_BITS 16
+
+// Touched blocks are bits in 8 KB bitmaps, each covering 16 MB of addresses
+#define ANALYZER_BITMAP_BLOCKS (1u << 16)
+
+// Reuse distances over a stream of keys: the number of distinct keys seen
+// since the previous access to the same key. Each access marks its slot in
+// a Fenwick tree and clears the slot of that key's previous access, so a
+// distance is a range count, O(log n). When the slots run out, the live
+// marks are packed to the front, so memory follows the distinct keys rather
+// than the length of the stream.
+class ReuseDistance {
+private:
+    std::vector<uint32_t> _tree; // 1-based Fenwick tree over slots
+    std::vector<uint64_t> _times; // access time of each slot, increasing
+    std::unordered_map<uint64_t, uint32_t> _last; // slot of each key's latest access
+    uint32_t _used;
+    uint64_t _time;
+
+    void add(uint32_t slot, int delta);
+    uint32_t prefix(uint32_t slots);
+    void compact();
+
+public:
+    ReuseDistance();
+
+    uint64_t access(uint64_t key);
+    void remove(uint64_t key);
+    uint32_t distinctSince(uint64_t time);
+    uint32_t distinct();
+    uint64_t time();
+};
+
+// Page accesses of one process, in the process's own access count
+typedef struct ProcessReuse {
+    ReuseDistance pages;
+    std::vector<std::vector<uint64_t> > blocks; // bitmaps of the blocks touched, allocated on first touch
+    bool exited; // pages and blocks are dropped once the process exits
+    uint64_t accesses;
+    uint64_t cold;
+    uint64_t histogram[REUSE_BUCKETS];
+    uint64_t working_set_total; // sum of the working set after every access
+    uint32_t working_set_peak;
+    uint64_t footprint[ANALYZER_MAX_PAGE_BITS + 1]; // pages per page size, kept on exit
+} ProcessReuse;
+
+// Working-set and reuse-distance analysis of every variable access. The
+// working set is the number of distinct pages in the process's last
+// `window` accesses.
+class WorkingSetAnalyzer {
+private:
+    uint32_t _page_size;
+    uint64_t _window;
+    std::unordered_map<uint32_t, ProcessReuse> _processes;
+    uint32_t _cached_pid;
+    ProcessReuse *_cached_process;
+
+    ProcessReuse* process(uint32_t pid);
+    void countFootprint(ProcessReuse *process, uint64_t *footprint);
+
+public:
+    WorkingSetAnalyzer(uint32_t page_size, uint64_t window);
+
+    void access(uint32_t pid, uint32_t virtual_address, uint32_t size);
+    void processExited(uint32_t pid);
+
+    void print();
+};
+
+#endif // __ANALYZER_H_
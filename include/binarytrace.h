@@ -0,0 +1,59 @@
+#ifndef __BINARYTRACE_H_
+#define __BINARYTRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "command.h"
+
+#define BINARY_TRACE_MAGIC 0x5442534d // "MSBT"
+#define BINARY_TRACE_VERSION 1
+
+// Bytes of the trace mapped at once while replaying
+#define BINARY_TRACE_CHUNK (64u << 20)
+
+// Every record starts with one opcode byte. Fields that follow are native
+// endian 32-bit values unless noted; variable names are interned, so each
+// name is written once in a TraceDefineName record and referred to by id.
+//   TraceDefineName  id, length, <length name bytes>
+//   TraceCreate      text_size, data_size
+//   TraceAllocate    pid, name, type (8-bit), count
+//   TraceSet         pid, name, offset, type (8-bit), count, <count packed values>
+//   TracePrint       pid, name
+//   TraceFree        pid, name
+//   TraceTerminate   pid
+//   TraceText        length, <length command bytes> (anything else, run through the parser)
+enum TraceOpcode : uint8_t {TraceDefineName, TraceCreate, TraceAllocate, TraceSet, TracePrint, TraceFree, TraceTerminate, TraceText};
+
+// Captures the commands of a session in the binary trace format
+class TraceRecorder {
+private:
+    FILE *_file;
+    std::unordered_map<std::string, uint32_t> _names;
+    std::vector<char> _record;
+
+    uint32_t internName(const char *text, uint32_t length);
+    void beginRecord(TraceOpcode opcode);
+    void put32(uint32_t value);
+    void putBytes(const void *data, uint32_t length);
+    void endRecord();
+    void recordText(std::vector<Token> &args);
+
+public:
+    TraceRecorder(std::string path);
+    ~TraceRecorder();
+
+    bool isOpen();
+
+    // Records one command as it is about to run; the simulator is only read,
+    // to learn the element type of a variable being set
+    void record(std::vector<Token> &args, Simulator *sim);
+};
+
+// Replays a binary trace through the simulator, returning the number of
+// commands run or -1 if the file could not be read
+long runBinaryTrace(std::string path, Simulator *sim);
+
+#endif // __BINARYTRACE_H_
@@ -0,0 +1,69 @@
+#ifndef __CACHE_H_
+#define __CACHE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// L1, L2 and a last-level cache at most
+#define CACHE_MAX_LEVELS 3
+
+typedef struct CacheLine {
+    bool valid;
+    bool dirty;
+    uint64_t tag; // physical address / line size
+    uint64_t stamp; // last use, for LRU
+} CacheLine;
+
+// One set-associative LRU level. Write-back levels allocate on a write miss
+// and hold dirty lines until they are evicted; write-through levels pass
+// every write on and do not allocate on a write miss.
+typedef struct CacheLevel {
+    uint64_t size;
+    uint32_t line_size;
+    uint32_t ways;
+    uint32_t num_sets;
+    bool write_back;
+    std::vector<CacheLine> lines;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks; // dirty lines written to the next level on eviction
+} CacheLevel;
+
+// Demand accesses of one process, per level; an access reaches a level only
+// after missing every level before it
+typedef struct CacheCounts {
+    uint64_t hits[CACHE_MAX_LEVELS];
+    uint64_t misses[CACHE_MAX_LEVELS];
+} CacheCounts;
+
+// Physically indexed and tagged caches fed with the physical address of
+// every variable access, after translation
+class CacheHierarchy {
+private:
+    std::vector<CacheLevel> _levels;
+    std::unordered_map<uint32_t, CacheCounts> _processes;
+    uint32_t _cached_pid;
+    CacheCounts *_cached_counts;
+    uint64_t _clock;
+    uint64_t _memory_reads;
+    uint64_t _memory_writes;
+
+    CacheCounts* counts(uint32_t pid);
+    void accessLine(uint32_t level, uint64_t address, bool write, CacheCounts *demand);
+
+public:
+    CacheHierarchy();
+    ~CacheHierarchy();
+
+    static bool parseWritePolicy(std::string name, bool *write_back);
+
+    bool addLevel(uint64_t size, uint32_t line_size, uint32_t ways, bool write_back);
+    uint32_t numLevels();
+    void access(uint32_t pid, uint64_t physical_address, uint32_t size, bool write);
+
+    void print();
+};
+
+#endif // __CACHE_H_
@@ -0,0 +1,46 @@
+#ifndef __COMMAND_H_
+#define __COMMAND_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "simulator.h"
+#include "workload.h"
+
+// A view into the command text; tokens are never copied out of the input
+typedef struct Token {
+    const char *text;
+    uint32_t length;
+} Token;
+
+typedef void (*CommandHandler)(std::vector<Token> &args, Simulator *sim);
+
+typedef struct Command {
+    const char *name;
+    int min_args;
+    CommandHandler handler;
+} Command;
+
+void tokenize(const char *line, const char *end, std::vector<Token> &tokens);
+bool tokenEquals(Token token, const char *text);
+std::string tokenString(Token token);
+bool parseLong(Token token, long *value);
+bool parseDouble(Token token, double *value);
+bool parseDataType(Token token, DataType *type);
+
+// Converts args[first..] into packed values of `type`, reporting the first bad token
+bool parseValues(std::vector<Token> &args, uint32_t first, DataType type, void *out, Token *invalid);
+
+// Runs one tokenized command, returning false once the session should end
+bool executeCommand(std::vector<Token> &args, Simulator *sim);
+
+// Maps a trace file read-only; *data is NULL for an empty file
+bool mapTrace(std::string path, const char **data, size_t *size);
+
+// Replays a command file without prompts, returning the number of commands run
+long runTrace(std::string path, Simulator *sim);
+
+// Runs generated commands straight through the engine without a trace file
+long runWorkload(WorkloadGenerator *generator, Simulator *sim);
+
+#endif // __COMMAND_H_
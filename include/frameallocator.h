@@ -0,0 +1,45 @@
+#ifndef __FRAMEALLOCATOR_H_
+#define __FRAMEALLOCATOR_H_
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+
+// Hierarchical bitmap of free physical frames. A set bit in level 0 marks a
+// free frame; a set bit in level n marks a level n-1 word with a free bit.
+// allocate() and release() may be called from several page tables at once.
+// Frames shared copy-on-write carry a reference count, and release() only
+// frees a frame once its last reference is dropped.
+class FrameAllocator {
+private:
+    std::mutex _lock;
+    uint32_t _num_frames;
+    uint32_t _num_free;
+    uint32_t _num_shared;
+    std::vector<std::vector<uint64_t> > _levels;
+    std::vector<uint32_t> _refs;
+
+    void setFree(uint32_t frame);
+    void clearFree(uint32_t frame);
+    int64_t findFrom(int level, uint64_t from);
+
+public:
+    FrameAllocator(uint32_t num_frames);
+    ~FrameAllocator();
+
+    int allocate();
+    void release(int frame);
+    int allocateIn(uint32_t first, uint32_t end, uint32_t stride, uint32_t offset);
+    int allocateRun(uint32_t count);
+    void releaseRun(int first, uint32_t count);
+    bool claim(int frame);
+    void share(int frame);
+    uint32_t refCount(int frame);
+    bool isFree(int frame);
+
+    uint32_t numFrames();
+    uint32_t numFree();
+    uint32_t numShared();
+};
+
+#endif // __FRAMEALLOCATOR_H_
@@ -0,0 +1,92 @@
+#ifndef __HEAP_H_
+#define __HEAP_H_
+
+#include <stdint.h>
+#include <string>
+#include <set>
+#include <vector>
+
+enum HeapPolicy : uint8_t {FirstFit, BestFit, NextFit, Buddy, Segregated};
+
+class SnapshotWriter;
+class SnapshotReader;
+
+#define HEAP_NUM_CLASSES 33
+#define HEAP_BUDDY_MIN_ORDER 3 // smallest buddy block is 8 bytes
+
+typedef struct HeapStats {
+    uint32_t free_blocks;
+    uint64_t free_bytes;
+    uint32_t largest_free;
+    uint32_t holes;          // free blocks below the top of the heap
+    uint64_t hole_bytes;
+    uint32_t largest_hole;
+    uint64_t internal_waste; // bytes lost to rounding (buddy only)
+    uint64_t merges;
+} HeapStats;
+
+// Free block in the address-ordered treap; max_size covers the whole subtree
+typedef struct FreeBlock {
+    uint32_t address;
+    uint32_t size;
+    uint32_t priority;
+    uint32_t max_size;
+    struct FreeBlock *left;
+    struct FreeBlock *right;
+} FreeBlock;
+
+// Per-process virtual heap. Every policy except buddy shares the address
+// index, so coalescing a freed range with its neighbours is O(log n).
+class Heap {
+private:
+    HeapPolicy _policy;
+    uint32_t _size;
+    FreeBlock *_root;
+    uint32_t _rand_state;
+    std::set<std::pair<uint32_t, uint32_t> > _by_size;  // (size, address) for best-fit
+    std::set<uint32_t> _classes[HEAP_NUM_CLASSES];      // addresses by floor(log2(size))
+    std::set<uint32_t> _buddy_free[HEAP_NUM_CLASSES];   // addresses by buddy order
+    uint32_t _next_fit;
+    uint64_t _internal_waste;
+    uint64_t _merges;
+
+    static uint32_t sizeClass(uint32_t size);
+    static uint32_t buddyOrder(uint32_t size);
+    static void update(FreeBlock *node);
+    static void split(FreeBlock *node, uint32_t address, FreeBlock **left, FreeBlock **right);
+    static FreeBlock* join(FreeBlock *left, FreeBlock *right);
+    static FreeBlock* firstFit(FreeBlock *node, uint32_t from, uint32_t size);
+    static void destroy(FreeBlock *node);
+    static void collect(FreeBlock *node, std::vector<FreeBlock*> &blocks);
+
+    FreeBlock* find(uint32_t address);
+    FreeBlock* predecessor(uint32_t address);
+    FreeBlock* successor(uint32_t address);
+    void insertBlock(uint32_t address, uint32_t size);
+    void eraseBlock(uint32_t address);
+    void carve(FreeBlock *block, uint32_t size);
+
+    void getBlocks(std::vector<std::pair<uint32_t, uint32_t> > &blocks);
+    void setBlocks(std::vector<std::pair<uint32_t, uint32_t> > &blocks);
+
+    bool allocateBuddy(uint32_t size, uint32_t *address);
+    void releaseBuddy(uint32_t address, uint32_t size);
+
+public:
+    Heap(uint32_t size, HeapPolicy policy);
+    ~Heap();
+
+    static bool parsePolicy(std::string name, HeapPolicy *policy);
+    static const char* policyName(HeapPolicy policy);
+
+    HeapPolicy policy();
+    bool allocate(uint32_t size, uint32_t *address);
+    void release(uint32_t address, uint32_t size);
+    void getStats(uint32_t top, HeapStats *stats);
+
+    Heap* clone();
+    void save(SnapshotWriter &writer);
+    static Heap* load(SnapshotReader &reader);
+};
+
+#endif // __HEAP_H_
@@ -4,6 +4,13 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include "heap.h"
+#include "pool.h"
+
+class SnapshotWriter;
+class SnapshotReader;
 
 enum DataType : uint8_t {FreeSpace, Char, Short, Int, Float, Long, Double};
 
@@ -16,29 +23,67 @@ typedef struct Variable {
 
 typedef struct Process {
     uint32_t pid;
-    std::vector<Variable*> variables;
+    std::map<uint32_t, Variable*> variables; // live variables ordered by virtual address
+    std::unordered_map<std::string, Variable*> index;
+    Heap *heap; // free space in the process's virtual address space
 } Process;
 
+// PIDs are PID_BASE + (generation << PID_SLOT_BITS | slot). When the MMU is
+// split into shards, the replay dispatcher picks each new process's slot and
+// generation as a single MMU would, so PIDs match a serial run, and the shard
+// that gets the process keeps it at that slot.
+#define PID_BASE 1024
+#define PID_SLOT_BITS 20
+#define PID_SLOT_MASK ((1u << PID_SLOT_BITS) - 1)
+
+typedef struct ProcessSlot {
+    Process *proc;
+    uint32_t generation; // bumped each time the slot is vacated
+} ProcessSlot;
+
 class Mmu {
 private:
-    uint32_t _next_pid;
-    uint32_t _max_size;
-    std::vector<Process*> _processes;
+    uint32_t _base_pid;
+    uint32_t _max_size; // virtual address space of each process
+    std::vector<ProcessSlot> _slots;
+    std::vector<uint32_t> _free_slots;
+    bool _sharded; // a parallel replay picks the slots, even with one shard
+    bool _slot_assigned; // the next process takes _next_slot at _next_generation
+    uint32_t _next_slot;
+    uint32_t _next_generation;
+    HeapPolicy _heap_policy;
+    ObjectPool<Process> _process_pool;
+    ObjectPool<Variable> _variable_pool;
+
+    Process* newProcess();
+    void releaseProcess(Process *proc);
+    ProcessSlot* lookupSlot(uint32_t pid);
+    void processHeapStats(Process *proc, HeapStats *stats);
 
 public:
-    Mmu(int memory_size);
+    Mmu(uint32_t virtual_size);
     ~Mmu();
 
+    void setHeapPolicy(HeapPolicy policy);
+    void setSharded();
+    bool isSharded();
+    void assignSlot(uint32_t slot, uint32_t generation);
     uint32_t createProcess();
+    uint32_t forkProcess(uint32_t pid);
     void addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint32_t size, uint32_t address);
     Process* getProcessAt(uint32_t pid);
-    Variable* getVariableAt(uint32_t pid, std::string desiredVar);
+    Variable* getVariableAt(uint32_t pid, const std::string &desiredVar);
+    void checkAndMerge(uint32_t pid, Variable *var);
     void killProcess(uint32_t pid);
-    void checkAndMerge(uint32_t pid, Variable *var, uint32_t page_size);
     int isProcessInMMU(uint32_t pid);
     void printProcesses();
-    void mergeHelper(int lrc, Process *inq, int pgstart, int pgend, int toCheck);
+    void getHeapTotals(HeapStats *total);
+    void printHeap();
+    void printFootprint();
     void print();
+
+    void save(SnapshotWriter &writer);
+    bool load(SnapshotReader &reader, uint64_t *variable_bytes);
 };
 
 #endif // __MMU_H_
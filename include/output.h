@@ -0,0 +1,11 @@
+#ifndef __OUTPUT_H_
+#define __OUTPUT_H_
+
+#include <iostream>
+
+// Stream that command output is written to on the calling thread. Defaults
+// to std::cout; replay workers point it at their own buffer.
+std::ostream& simOut();
+void setSimOut(std::ostream *out);
+
+#endif // __OUTPUT_H_
@@ -6,38 +6,133 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include "frameallocator.h"
+#include "tlb.h"
+#include "cache.h"
+#include "analyzer.h"
+#include "sweep.h"
+#include "swapfile.h"
+#include "replacement.h"
+#include "placement.h"
 
-struct PageTableKeyComparator
-{
-    inline bool operator() (const std::string& str1, const std::string& str2)
-    {
-        size_t sep1 = str1.find("|");
-        uint32_t pid1 = std::stoi(str1.substr(0, sep1));
-        int page1 = std::stoi(str1.substr(sep1 + 1));
-        size_t sep2 = str2.find("|");
-        uint32_t pid2 = std::stoi(str2.substr(0, sep2));
-        int page2 = std::stoi(str2.substr(sep2 + 1));
-
-        return (pid1 < pid2 || (pid1 == pid2 && page1 < page2));
-    }
-};
+class SnapshotWriter;
+class SnapshotReader;
+
+// Number of page table entries held by each second-level table
+#define PT_LEAF_BITS 10
+#define PT_LEAF_ENTRIES (1 << PT_LEAF_BITS)
+
+// A page is resident when frame != -1 and swapped out when swap_slot != -1.
+// live_bytes counts the variable bytes on the page; it is released at zero.
+typedef struct PageTableEntry {
+    int frame;
+    int swap_slot;
+    uint32_t live_bytes;
+} PageTableEntry;
+
+// A large page maps an aligned run of pages onto as many contiguous frames
+// with a single entry. Large pages stay resident even when swap is enabled.
+typedef struct LargePageEntry {
+    int frame; // first frame of the run, -1 when not mapped
+    uint32_t live_bytes;
+} LargePageEntry;
 
 class PageTable {
 private:
+    // Two-level radix table for a single process. Second-level tables are
+    // only allocated once one of their pages is mapped.
+    typedef struct ProcessPages {
+        std::vector<PageTableEntry*> leaves;
+        std::vector<LargePageEntry> large; // indexed by large page number
+        uint32_t num_entries;
+    } ProcessPages;
+
+    typedef struct FrameOwner {
+        uint32_t pid;
+        uint32_t page_number;
+    } FrameOwner;
+
     int _page_size;
-    std::map<std::string, int> _table;
+    uint32_t _large_factor; // pages per large page, 1 when disabled
+    FrameAllocator *_frames;
+    bool _owns_frames;
+    std::map<uint32_t, ProcessPages> _table;
+    uint32_t _cached_pid;
+    ProcessPages *_cached_pages;
+    Tlb *_tlb;
+    CacheHierarchy *_cache;
+    WorkingSetAnalyzer *_analyzer;
+    PageSweep *_sweep;
+    FramePlacement *_placement;
+    std::ostream *_reference_log;
 
-    std::vector<std::string> sortedKeys();
+    // Demand paging state, only used once swap is enabled
+    void *_memory;
+    SwapFile *_swap;
+    ReplacementPolicy *_replacement;
+    std::vector<FrameOwner> _owners;
+    uint64_t _page_faults;
+    uint64_t _evictions;
+    uint64_t _bytes_swapped_in;
+    uint64_t _bytes_swapped_out;
+
+    // Copy-on-write state, only used once a process has been forked
+    bool _forked;
+    uint64_t _cow_faults;
+
+    ProcessPages* lookupProcess(uint32_t pid);
+    PageTableEntry* lookupEntry(uint32_t pid, uint32_t page_number);
+    LargePageEntry* lookupLarge(ProcessPages *pages, uint32_t page_number);
+    uint32_t* liveBytes(uint32_t pid, uint32_t page_number);
+    void printLargeRows(uint32_t pid, ProcessPages &pages, uint64_t before, uint32_t *next);
+    int obtainFrame(uint32_t pid, uint32_t page_number);
+    void evictFrame(int frame);
 
 public:
-    PageTable(int page_size);
+    PageTable(int page_size, uint64_t memory_size);
+    PageTable(int page_size, FrameAllocator *frames); // frames shared with other page tables
     ~PageTable();
 
+    void setTlb(Tlb *tlb);
+    void flushTlb(uint32_t pid);
+    void setCache(CacheHierarchy *cache);
+    CacheHierarchy* cache();
+    void setAnalyzer(WorkingSetAnalyzer *analyzer);
+    WorkingSetAnalyzer* analyzer();
+    void setSweep(PageSweep *sweep);
+    PageSweep* sweep();
+    void setPlacement(FramePlacement *placement);
+    FramePlacement* placement();
+    void setReferenceLog(std::ostream *log);
+    void enableSwap(void *memory, SwapFile *swap, ReplacementPolicy *replacement);
+    void enableLargePages(uint32_t large_page_size);
+    uint32_t largePageFactor();
+
     void addEntry(uint32_t pid, int page_number);
-    int getPhysicalAddress(uint32_t pid, uint32_t virtual_address);
+    bool addLargeEntry(uint32_t pid, int page_number);
+    bool isMapped(uint32_t pid, int page_number);
+    int64_t getPhysicalAddress(uint32_t pid, uint32_t virtual_address);
+    int64_t getWritableAddress(uint32_t pid, uint32_t virtual_address, void *memory);
+    void forkProcess(uint32_t parent, uint32_t child);
     void removePageEntry(uint32_t pid, int page_num);
+    void addLiveBytes(uint32_t pid, int page_number, uint32_t bytes);
+    void removeLiveBytes(uint32_t pid, int page_number, uint32_t bytes);
+    void removeProcess(uint32_t pid);
+    void clear();
+
+    uint64_t pageFaults();
+    uint32_t framesInUse();
+    uint32_t numFrames();
+    uint32_t sharedFrames();
+    uint64_t cowFaults();
 
     void print();
+    void printSwap();
+    void printLargePages();
+    void printPlacement();
+
+    void save(SnapshotWriter &writer, void *memory);
+    bool load(SnapshotReader &reader, void *memory);
 };
 
 #endif // __PAGETABLE_H_
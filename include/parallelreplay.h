@@ -0,0 +1,17 @@
+#ifndef __PARALLELREPLAY_H_
+#define __PARALLELREPLAY_H_
+
+#include <string>
+#include <vector>
+#include "simulator.h"
+
+// Replays a command file with one worker thread per shard. Commands for a
+// process run on the shard that holds it. New processes get the PIDs a
+// serial replay would give them and are spread across shards by slot, except
+// that a forked child stays with its parent. Output is written in trace order, and commands
+// that inspect the whole machine (print mmu, page, ...) wait for every shard
+// to catch up before running against each shard in turn.
+// Returns the number of commands run, or -1 if the trace could not be read.
+long runTraceParallel(std::string path, std::vector<Simulator*> &shards);
+
+#endif // __PARALLELREPLAY_H_
@@ -0,0 +1,72 @@
+#ifndef __PLACEMENT_H_
+#define __PLACEMENT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "frameallocator.h"
+
+// Chooses the frame a newly mapped page goes into. Without a placement
+// policy the page table simply takes the lowest free frame.
+class FramePlacement {
+public:
+    virtual ~FramePlacement() {}
+
+    virtual const char* name() = 0;
+    virtual int allocate(FrameAllocator *frames, uint32_t pid, uint32_t page_number) = 0;
+    virtual void frameAccessed(int frame, uint32_t pid) {}
+
+    // Narrows [first, end) to the frames an eviction has to free for the
+    // page to be placed; policies that fall back anywhere leave it alone
+    virtual void victimRange(uint32_t pid, uint32_t page_number, uint32_t *first, uint32_t *end) {}
+    virtual void print(FrameAllocator *frames) = 0;
+
+    // `count` is the number of colors for "color" and of nodes otherwise
+    static FramePlacement* create(std::string name, uint32_t count, uint32_t num_frames);
+};
+
+// Page coloring: frame % colors picks the cache sets a page maps to, so
+// consecutive pages of a process get consecutive colors. A page takes a frame
+// of another color only when its own color is used up.
+class ColorPlacement : public FramePlacement {
+private:
+    uint32_t _colors;
+    uint64_t _fallbacks;
+
+public:
+    ColorPlacement(uint32_t colors);
+
+    const char* name();
+    int allocate(FrameAllocator *frames, uint32_t pid, uint32_t page_number);
+    void print(FrameAllocator *frames);
+};
+
+enum NumaPolicy : uint8_t {NumaFirstTouch, NumaInterleave, NumaBind};
+
+// Frames are split into equal contiguous nodes, and process pid runs on node
+// pid % nodes. First touch places pages on the process's node, interleave
+// spreads them round-robin by page number, and both fall back to the next
+// node with a free frame. Bind never leaves the process's node.
+class NumaPlacement : public FramePlacement {
+private:
+    NumaPolicy _policy;
+    uint32_t _num_nodes;
+    uint32_t _num_frames;
+    std::vector<uint64_t> _local_accesses; // per node holding the frame
+    std::vector<uint64_t> _remote_accesses;
+    uint64_t _fallbacks;
+
+    uint32_t nodeOf(int frame);
+    uint32_t nodeStart(uint32_t node);
+
+public:
+    NumaPlacement(NumaPolicy policy, uint32_t num_nodes, uint32_t num_frames);
+
+    const char* name();
+    int allocate(FrameAllocator *frames, uint32_t pid, uint32_t page_number);
+    void frameAccessed(int frame, uint32_t pid);
+    void victimRange(uint32_t pid, uint32_t page_number, uint32_t *first, uint32_t *end);
+    void print(FrameAllocator *frames);
+};
+
+#endif // __PLACEMENT_H_
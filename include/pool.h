@@ -0,0 +1,80 @@
+#ifndef __POOL_H_
+#define __POOL_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#define POOL_CHUNK_OBJECTS 1024
+
+// Slab allocator for fixed-size records. Objects are carved out of large
+// chunks and recycled through a free list, so allocation never touches the
+// system heap once the pool has warmed up.
+template <typename T>
+class ObjectPool {
+private:
+    // Free objects reuse their own storage as the free-list link
+    union Slot {
+        Slot *next;
+        char storage[sizeof(T)];
+    } __attribute__((aligned(alignof(T))));
+
+    std::vector<Slot*> _chunks;
+    Slot *_free;
+    uint64_t _live;
+
+    void grow()
+    {
+        Slot *chunk = (Slot*)malloc(sizeof(Slot) * POOL_CHUNK_OBJECTS);
+        for (int i = 0; i < POOL_CHUNK_OBJECTS; i++)
+        {
+            chunk[i].next = (i + 1 < POOL_CHUNK_OBJECTS) ? &chunk[i + 1] : _free;
+        }
+        _free = chunk;
+        _chunks.push_back(chunk);
+    }
+
+public:
+    ObjectPool()
+    {
+        _free = NULL;
+        _live = 0;
+    }
+
+    // Any object still live is abandoned without its destructor running
+    ~ObjectPool()
+    {
+        for (int i = 0; i < _chunks.size(); i++)
+        {
+            free(_chunks[i]);
+        }
+    }
+
+    T* acquire()
+    {
+        if (_free == NULL)
+        {
+            grow();
+        }
+        Slot *slot = _free;
+        _free = slot->next;
+        _live++;
+        return new (slot->storage) T();
+    }
+
+    void release(T *object)
+    {
+        object->~T();
+        Slot *slot = (Slot*)object;
+        slot->next = _free;
+        _free = slot;
+        _live--;
+    }
+
+    uint64_t live() { return _live; }
+    uint64_t capacity() { return (uint64_t)_chunks.size() * POOL_CHUNK_OBJECTS; }
+    uint64_t bytesReserved() { return (uint64_t)_chunks.size() * POOL_CHUNK_OBJECTS * sizeof(Slot); }
+};
+
+#endif // __POOL_H_
@@ -0,0 +1,113 @@
+#ifndef __REPLACEMENT_H_
+#define __REPLACEMENT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Interface for choosing which resident frame to evict under memory pressure
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() {}
+
+    virtual const char* name() = 0;
+    virtual void pageLoaded(int frame, uint32_t pid, uint32_t page_number) = 0;
+    virtual void pageAccessed(int frame, uint32_t pid, uint32_t page_number) = 0;
+    virtual void pageReleased(int frame) = 0;
+    // Picks a resident frame in [first, end) to evict, or -1 if there is none
+    virtual int selectVictim(uint32_t first, uint32_t end) = 0;
+
+    static ReplacementPolicy* create(std::string name, uint32_t num_frames, std::string reference_file);
+};
+
+// Doubly-linked list threaded through frame numbers, used by FIFO and LRU
+class FrameList {
+private:
+    std::vector<int> _prev;
+    std::vector<int> _next;
+    int _head;
+    int _tail;
+
+public:
+    FrameList(uint32_t num_frames);
+
+    bool contains(int frame);
+    void pushBack(int frame);
+    void remove(int frame);
+    int front();
+    int next(int frame);
+};
+
+class FifoReplacement : public ReplacementPolicy {
+private:
+    FrameList _queue;
+
+public:
+    FifoReplacement(uint32_t num_frames);
+
+    const char* name();
+    void pageLoaded(int frame, uint32_t pid, uint32_t page_number);
+    void pageAccessed(int frame, uint32_t pid, uint32_t page_number);
+    void pageReleased(int frame);
+    int selectVictim(uint32_t first, uint32_t end);
+};
+
+class LruReplacement : public ReplacementPolicy {
+private:
+    FrameList _recency; // least recently used at the front
+
+public:
+    LruReplacement(uint32_t num_frames);
+
+    const char* name();
+    void pageLoaded(int frame, uint32_t pid, uint32_t page_number);
+    void pageAccessed(int frame, uint32_t pid, uint32_t page_number);
+    void pageReleased(int frame);
+    int selectVictim(uint32_t first, uint32_t end);
+};
+
+class ClockReplacement : public ReplacementPolicy {
+private:
+    std::vector<uint8_t> _resident;
+    std::vector<uint8_t> _referenced;
+    uint32_t _hand;
+
+public:
+    ClockReplacement(uint32_t num_frames);
+
+    const char* name();
+    void pageLoaded(int frame, uint32_t pid, uint32_t page_number);
+    void pageAccessed(int frame, uint32_t pid, uint32_t page_number);
+    void pageReleased(int frame);
+    int selectVictim(uint32_t first, uint32_t end);
+};
+
+// Belady's optimal algorithm. Future accesses come from a reference string
+// file holding one "<PID> <page_number>" pair per line, in access order.
+class OptimalReplacement : public ReplacementPolicy {
+private:
+    typedef struct FutureUses {
+        std::vector<uint64_t> positions;
+        uint32_t cursor;
+    } FutureUses;
+
+    std::unordered_map<uint64_t, FutureUses> _future;
+    std::vector<uint64_t> _frame_keys;
+    std::vector<uint8_t> _resident;
+    uint64_t _time;
+
+    uint64_t nextUse(uint64_t key);
+
+public:
+    OptimalReplacement(uint32_t num_frames, std::string reference_file);
+
+    bool loaded();
+    const char* name();
+    void pageLoaded(int frame, uint32_t pid, uint32_t page_number);
+    void pageAccessed(int frame, uint32_t pid, uint32_t page_number);
+    void pageReleased(int frame);
+    int selectVictim(uint32_t first, uint32_t end);
+};
+
+#endif // __REPLACEMENT_H_
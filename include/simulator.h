@@ -0,0 +1,48 @@
+#ifndef __SIMULATOR_H_
+#define __SIMULATOR_H_
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include "mmu.h"
+#include "pagetable.h"
+#include "tlb.h"
+#include "swapfile.h"
+#include "output.h"
+
+class TraceRecorder;
+
+// Everything a command needs to act on the simulated machine
+typedef struct Simulator {
+    Mmu *mmu;
+    PageTable *page_table;
+    void *memory;
+    int page_size;
+    Tlb *tlb;
+    SwapFile *swap;
+    TraceRecorder *recorder; // captures executed commands when recording
+} Simulator;
+
+extern std::atomic<int64_t> mem_utilization; // bytes allocated across every process and shard
+extern uint64_t memory_size; // bytes of simulated physical memory
+extern bool swap_enabled; // allow allocations to overcommit physical memory
+
+void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table, int page_size);
+void forkProcess(uint32_t pid, Mmu *mmu, PageTable *page_table);
+void allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table, int page_size);
+void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *values, uint32_t num_values, Mmu *mmu, PageTable *page_table, void *memory, int page_size);
+void writeVariable(uint32_t pid, Variable *var, uint32_t offset, void *values, uint32_t num_values, PageTable *page_table, void *memory, int page_size);
+bool readVariable(uint32_t pid, Variable *var, uint32_t offset, void *values, uint32_t num_values, PageTable *page_table, void *memory, int page_size);
+void printVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, void *memory, int page_size);
+void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, int page_size);
+void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table, int page_size);
+int getTypeByteSize(DataType type);
+void checkAndFreePage(uint32_t pid, uint32_t address, uint32_t size, PageTable *page_table, int page_size);
+bool copyToVirtual(uint32_t pid, uint32_t virtual_address, const void *data, uint32_t size, PageTable *page_table, void *memory, int page_size);
+bool copyFromVirtual(uint32_t pid, uint32_t virtual_address, void *data, uint32_t size, PageTable *page_table, void *memory, int page_size);
+
+// Checkpoint the whole simulator to a file and load it back (see snapshot.h)
+bool saveSnapshot(std::string path, Simulator *sim);
+bool restoreSnapshot(std::string path, Simulator *sim);
+
+#endif // __SIMULATOR_H_
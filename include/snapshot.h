@@ -0,0 +1,67 @@
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#define SNAPSHOT_MAGIC 0x4e53534d // "MSSN"
+#define SNAPSHOT_VERSION 2
+
+// A snapshot is a fixed header followed by the payload written by
+// Mmu::save and PageTable::save. Fields are native endian.
+//   header   magic, version, page_size, large_factor (32-bit each),
+//            payload length, payload FNV-1a hash (64-bit each)
+typedef struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t large_factor;
+    uint64_t length;
+    uint64_t hash;
+} SnapshotHeader;
+
+// Writes a snapshot through a buffered FILE, hashing the payload on the way
+// so finish() can fill in the header
+class SnapshotWriter {
+private:
+    FILE *_file;
+    uint64_t _length;
+    uint64_t _hash;
+
+public:
+    SnapshotWriter(std::string path);
+    ~SnapshotWriter();
+
+    bool isOpen();
+    void put8(uint8_t value);
+    void put32(uint32_t value);
+    void put64(uint64_t value);
+    void putBytes(const void *data, uint32_t length);
+    void putString(const std::string &text);
+    bool finish(uint32_t page_size, uint32_t large_factor);
+};
+
+// Reads a snapshot mapped into memory. open() checks the header and the
+// payload hash up front, so loading never stops halfway through a state.
+class SnapshotReader {
+private:
+    const char *_map;
+    size_t _map_size;
+    const char *_data;
+    uint64_t _size;
+    uint64_t _position;
+
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    bool open(std::string path, uint32_t page_size, uint32_t large_factor);
+    bool get8(uint8_t *value);
+    bool get32(uint32_t *value);
+    bool get64(uint64_t *value);
+    const char* getBytes(uint64_t length);
+    bool getString(std::string *text);
+};
+
+#endif // __SNAPSHOT_H_
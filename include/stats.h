@@ -0,0 +1,69 @@
+#ifndef __STATS_H_
+#define __STATS_H_
+
+#include <stdint.h>
+#include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+class Mmu;
+class PageTable;
+
+// Operations with their own latency histogram
+enum StatOperation : uint8_t {StatCreateProcess, StatAllocateVariable, StatWriteVariable, StatPrintVariable, StatFreeVariable,
+                              StatTerminateProcess, StatAddEntry, StatGetPhysicalAddress, StatCheckAndMerge, StatCheckAndFreePage,
+                              STAT_NUM_OPERATIONS};
+
+// Bucket n counts latencies in [2^(n-1), 2^n) ticks
+#define STAT_NUM_BUCKETS 48
+
+typedef struct LatencyHistogram {
+    uint64_t count;
+    uint64_t total_ticks;
+    uint64_t max_ticks;
+    uint64_t buckets[STAT_NUM_BUCKETS];
+} LatencyHistogram;
+
+// Cheapest monotonic clock available; converted to nanoseconds when printed
+inline uint64_t statTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Adds one sample to the calling thread's histogram for `operation`
+void statRecord(StatOperation operation, uint64_t ticks);
+
+// Writes latency histograms and machine counters to `out`
+void printStats(std::ostream &out, Mmu *mmu, PageTable *page_table);
+
+// The two halves of printStats: the histograms merged over every thread, and
+// the counters of one MMU and page table (one shard of a parallel replay)
+void printLatencyStats(std::ostream &out);
+void printMachineStats(std::ostream &out, Mmu *mmu, PageTable *page_table);
+
+// Times the enclosing scope. Build with STATS=0 to compile every timer out.
+#ifdef MEMSIM_STATS
+class ScopedStatTimer {
+private:
+    StatOperation _operation;
+    uint64_t _start;
+
+public:
+    ScopedStatTimer(StatOperation operation) : _operation(operation), _start(statTicks()) {}
+    ~ScopedStatTimer() { statRecord(_operation, statTicks() - _start); }
+};
+#define STAT_CONCAT_(a, b) a##b
+#define STAT_CONCAT(a, b) STAT_CONCAT_(a, b)
+#define STAT_TIMER(operation) ScopedStatTimer STAT_CONCAT(stat_timer_, __LINE__)(operation)
+#else
+#define STAT_TIMER(operation)
+#endif
+
+#endif // __STATS_H_
@@ -0,0 +1,29 @@
+#ifndef __SWAPFILE_H_
+#define __SWAPFILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Backing store for evicted pages, divided into page-sized slots
+class SwapFile {
+private:
+    std::string _path;
+    FILE *_file;
+    int _page_size;
+    int _num_slots;
+    std::vector<int> _free_slots;
+
+public:
+    SwapFile(std::string path, int page_size);
+    ~SwapFile();
+
+    bool isOpen();
+    int writePage(const void *data);
+    void readPage(int slot, void *data);
+    void release(int slot);
+    int slotsInUse();
+};
+
+#endif // __SWAPFILE_H_
@@ -0,0 +1,44 @@
+#ifndef __SWEEP_H_
+#define __SWEEP_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "analyzer.h"
+
+// One page size of a sweep. Every process shares the one LRU stack, as they
+// share physical memory.
+typedef struct SweepConfig {
+    uint32_t page_bits;
+    ReuseDistance stack; // keyed by pid << 32 | page number
+    std::unordered_map<uint32_t, std::vector<uint32_t> > pages; // pages on the stack per process
+    uint64_t references;
+    uint64_t cold;
+    uint64_t histogram[REUSE_BUCKETS];
+} SweepConfig;
+
+// Runs the accesses of one simulation against LRU memories of every
+// power-of-two size at several page sizes at once. LRU is a stack algorithm
+// (Mattson et al.): a memory of F frames holds the F most recently used
+// pages, so an access hits exactly when its reuse distance is below F, and
+// one reuse-distance histogram per page size gives the faults at every
+// frame count. The trace is parsed and its variables placed only once.
+class PageSweep {
+private:
+    std::vector<SweepConfig> _configs;
+    uint64_t _accesses;
+
+public:
+    PageSweep(const std::vector<uint32_t> &page_sizes);
+
+    // Comma-separated power-of-two sizes with optional K or M suffixes
+    static bool parseSizes(std::string list, std::vector<uint32_t> *page_sizes);
+
+    void access(uint32_t pid, uint32_t virtual_address, uint32_t size);
+    void processExited(uint32_t pid);
+
+    void print();
+};
+
+#endif // __SWEEP_H_
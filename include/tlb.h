@@ -0,0 +1,54 @@
+#ifndef __TLB_H_
+#define __TLB_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum TlbPolicy : uint8_t {TlbLru, TlbFifo, TlbRandom};
+
+// Set in an entry's page_number when it maps a large page; the remaining
+// bits then hold the large page number
+#define TLB_LARGE_PAGE 0x80000000u
+
+typedef struct TlbEntry {
+    bool valid;
+    uint32_t pid;
+    uint32_t page_number;
+    int frame;
+    uint64_t stamp; // last use for LRU, fill time for FIFO
+} TlbEntry;
+
+class Tlb {
+private:
+    uint32_t _num_sets;
+    uint32_t _ways;
+    TlbPolicy _policy;
+    std::vector<TlbEntry> _entries;
+    uint64_t _clock;
+    uint32_t _rand_state;
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _flushes;
+
+    TlbEntry* set(uint32_t pid, uint32_t page_number);
+    TlbEntry* find(uint32_t pid, uint32_t page_number);
+    uint32_t nextRandom();
+
+public:
+    Tlb(uint32_t num_entries, uint32_t ways, TlbPolicy policy);
+    ~Tlb();
+
+    static bool parsePolicy(std::string name, TlbPolicy *policy);
+
+    int lookup(uint32_t pid, uint32_t page_number);
+    int lookupMixed(uint32_t pid, uint32_t page_number, uint32_t large_number, bool *large);
+    void insert(uint32_t pid, uint32_t page_number, int frame);
+    void invalidate(uint32_t pid, uint32_t page_number);
+    void flushProcess(uint32_t pid);
+    void countEntries(uint32_t *valid, uint32_t *large);
+
+    void print();
+};
+
+#endif // __TLB_H_
@@ -0,0 +1,91 @@
+#ifndef __WORKLOAD_H_
+#define __WORKLOAD_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include "mmu.h"
+
+enum SizeDistribution : uint8_t {SizeUniform, SizeZipf, SizeBimodal};
+
+// Settings for a generated workload, parsed from "key=value,key=value"
+typedef struct WorkloadConfig {
+    uint64_t seed;
+    uint64_t operations;     // commands to emit, including the initial creates
+    uint32_t processes;      // processes alive at any time
+    SizeDistribution sizes;  // element count distribution for allocations
+    uint32_t min_elements;
+    uint32_t max_elements;
+    double zipf_exponent;
+    double large_fraction;   // share of large allocations for bimodal sizes
+    double lifetime;         // mean commands a variable lives, 0 = until its process ends
+    double process_lifetime; // mean commands a process lives, 0 = whole run
+    double locality;         // chance of reusing the last process and a recently touched variable
+    uint32_t values;         // values written by each set
+    uint64_t budget;         // bytes kept live across all processes
+} WorkloadConfig;
+
+// Emits a reproducible stream of commands in the prompt's command language.
+// PIDs are predicted with the same slot and generation rules as the MMU, so
+// the stream assumes it is replayed from a fresh simulator.
+class WorkloadGenerator {
+private:
+    typedef struct GenVariable {
+        uint64_t id;
+        uint32_t process;  // index into _processes
+        uint32_t position; // index into that process's variables
+        DataType type;
+        uint32_t count;
+    } GenVariable;
+
+    typedef struct GenProcess {
+        uint32_t pid;
+        uint64_t deadline;
+        std::vector<uint64_t> variables; // ids of live variables
+        std::deque<uint64_t> recent;     // recently touched variables, newest first
+    } GenProcess;
+
+    typedef std::pair<uint64_t, uint64_t> Death; // (time, variable id)
+
+    WorkloadConfig _config;
+    uint64_t _state;
+    uint64_t _emitted;
+    uint64_t _next_variable;
+    uint64_t _live_bytes;
+    int _last_process;
+    std::vector<GenProcess> _processes;
+    std::unordered_map<uint64_t, GenVariable> _variables;
+    std::priority_queue<Death, std::vector<Death>, std::greater<Death> > _deaths;
+    std::deque<std::string> _pending;
+    std::vector<double> _zipf_cdf;
+
+    // Mirror of the MMU's slot table, used to predict PIDs
+    std::vector<uint32_t> _generations;
+    std::vector<uint32_t> _free_slots;
+
+    uint64_t random();
+    double uniform();
+    double exponential(double mean);
+    uint32_t sampleElements();
+
+    void createProcess(int index);
+    void terminateProcess(int index);
+    void allocate(GenProcess &proc);
+    void release(uint64_t id);
+    void touch(GenProcess &proc);
+    void step();
+
+public:
+    WorkloadGenerator(WorkloadConfig config);
+
+    // Produces the next command; returns false once the workload is finished
+    bool next(std::string &line);
+
+    static void defaultConfig(WorkloadConfig *config);
+    static bool parseSpec(std::string spec, WorkloadConfig *config);
+};
+
+#endif // __WORKLOAD_H_
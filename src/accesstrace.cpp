@@ -0,0 +1,386 @@
+#include <cstring>
+#include <iomanip>
+#include <cerrno>
+#include <algorithm>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include "accesstrace.h"
+#include "command.h"
+
+AccessTraceReader::AccessTraceReader()
+{
+    _fd = -1;
+    _lengths[0] = 0;
+    _lengths[1] = 0;
+    _full[0] = false;
+    _full[1] = false;
+    _stopping = false;
+    _failed = false;
+    _current = -1;
+}
+
+AccessTraceReader::~AccessTraceReader()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+    }
+    _changed.notify_all();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+    if (_fd > 0)
+    {
+        close(_fd);
+    }
+}
+
+bool AccessTraceReader::open(std::string path)
+{
+    _fd = (path == "-") ? 0 : ::open(path.c_str(), O_RDONLY);
+    if (_fd == -1)
+    {
+        return false;
+    }
+    if (_fd > 0)
+    {
+        posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    _buffers[0].resize(ACCESS_TRACE_CHUNK);
+    _buffers[1].resize(ACCESS_TRACE_CHUNK);
+    _thread = std::thread(&AccessTraceReader::readLoop, this);
+    return true;
+}
+
+bool AccessTraceReader::failed()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _failed;
+}
+
+// Fills the buffers alternately, each as soon as the consumer hands it back.
+// An empty buffer marks the end of the input.
+void AccessTraceReader::readLoop()
+{
+    for (int i = 0; ; i ^= 1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            while (_full[i] && !_stopping)
+            {
+                _changed.wait(guard);
+            }
+            if (_stopping)
+            {
+                return;
+            }
+        }
+
+        size_t length = 0;
+        bool failed = false;
+        while (length < ACCESS_TRACE_CHUNK)
+        {
+            ssize_t count = read(_fd, _buffers[i].data() + length, ACCESS_TRACE_CHUNK - length);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                failed = (count < 0);
+                break;
+            }
+            length += count;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _lengths[i] = length;
+            _full[i] = true;
+            _failed = _failed || failed;
+        }
+        _changed.notify_all();
+        if (length == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool AccessTraceReader::next(const char **data, size_t *length)
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    if (_current != -1)
+    {
+        if (_lengths[_current] == 0)
+        {
+            return false; // the reader has already stopped
+        }
+        _full[_current] = false;
+        _changed.notify_all();
+    }
+    _current = (_current == -1) ? 0 : _current ^ 1;
+    while (!_full[_current])
+    {
+        _changed.wait(guard);
+    }
+    *data = _buffers[_current].data();
+    *length = _lengths[_current];
+    return *length > 0;
+}
+
+typedef struct AccessProcess {
+    uint64_t accesses;
+    uint64_t pages_touched;
+} AccessProcess;
+
+typedef struct AccessTraceRun {
+    Simulator *sim;
+    std::vector<Token> args;
+    uint64_t line_number;
+    uint64_t records;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t bytes;
+    uint64_t malformed;
+    uint32_t peak_frames;
+    std::unordered_map<uint32_t, AccessProcess> processes;
+} AccessTraceRun;
+
+// Decimal, or hex with a 0x prefix
+static bool parseAddress(Token token, uint64_t *value)
+{
+    uint32_t i = 0;
+    int base = 10;
+    if (token.length > 2 && token.text[0] == '0' && (token.text[1] == 'x' || token.text[1] == 'X'))
+    {
+        base = 16;
+        i = 2;
+    }
+    if (i == token.length || token.length - i > 16)
+    {
+        return false;
+    }
+
+    uint64_t result = 0;
+    for (; i < token.length; i++)
+    {
+        char c = token.text[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (base == 16 && c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        result = result * base + digit;
+    }
+    *value = result;
+    return true;
+}
+
+// Maps and translates every page the access touches, returning false once
+// physical memory runs out
+static bool runAccess(AccessTraceRun *run, uint32_t pid, bool write, uint32_t address, uint32_t size)
+{
+    PageTable *page_table = run->sim->page_table;
+    CacheHierarchy *cache = page_table->cache();
+    WorkingSetAnalyzer *analyzer = page_table->analyzer();
+    uint32_t page_size = run->sim->page_size;
+    AccessProcess &process = run->processes[pid];
+    process.accesses++;
+    if (page_table->sweep() != NULL)
+    {
+        page_table->sweep()->access(pid, address, size);
+    }
+    while (size > 0)
+    {
+        uint32_t chunk = std::min(size, page_size - address % page_size);
+        uint32_t page_number = address / page_size;
+        if (!page_table->isMapped(pid, page_number))
+        {
+            page_table->addEntry(pid, page_number);
+            if (!page_table->isMapped(pid, page_number))
+            {
+                return false;
+            }
+            process.pages_touched++;
+            run->peak_frames = std::max(run->peak_frames, page_table->framesInUse());
+        }
+
+        int64_t physical_address = page_table->getPhysicalAddress(pid, address);
+        if (physical_address == -1)
+        {
+            simOut() << "error: out of physical frames\n";
+            return false;
+        }
+        if (cache != NULL)
+        {
+            cache->access(pid, physical_address, chunk, write);
+        }
+        if (analyzer != NULL)
+        {
+            analyzer->access(pid, address, chunk);
+        }
+        address += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+static bool runRecord(AccessTraceRun *run, const char *line, const char *end)
+{
+    run->line_number++;
+    tokenize(line, end, run->args);
+    std::vector<Token> &args = run->args;
+    if (args.size() == 0 || args[0].text[0] == '#')
+    {
+        return true;
+    }
+
+    long pid;
+    uint64_t address, size;
+    bool write = args.size() == 4 && (tokenEquals(args[1], "W") || tokenEquals(args[1], "w"));
+    bool read = args.size() == 4 && (tokenEquals(args[1], "R") || tokenEquals(args[1], "r"));
+    if (!(read || write) || !parseLong(args[0], &pid) || pid < 0 || pid > UINT32_MAX
+     || !parseAddress(args[2], &address) || !parseAddress(args[3], &size) || size == 0 || address + size > (1ULL << 32))
+    {
+        simOut() << "error: malformed access record at line " << run->line_number << '\n';
+        run->malformed++;
+        return true;
+    }
+
+    run->records++;
+    run->reads += read;
+    run->writes += write;
+    run->bytes += size;
+    return runAccess(run, pid, write, address, size);
+}
+
+static void printAccessSummary(AccessTraceRun *run)
+{
+    Simulator *sim = run->sim;
+    uint64_t pages_touched = 0;
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, AccessProcess>::iterator it;
+    for (it = run->processes.begin(); it != run->processes.end(); it++)
+    {
+        pids.push_back(it->first);
+        pages_touched += it->second.pages_touched;
+    }
+    std::sort(pids.begin(), pids.end());
+
+    std::cout << "Records            | " << run->records << " (" << run->reads << " reads, " << run->writes << " writes, "
+              << run->bytes << " bytes)" << '\n';
+    std::cout << "Malformed records  | " << run->malformed << '\n';
+    std::cout << "Processes          | " << pids.size() << '\n';
+    std::cout << "Pages touched      | " << pages_touched << " (" << pages_touched * sim->page_size << " bytes)" << '\n';
+    std::cout << "Page faults        | " << pages_touched + sim->page_table->pageFaults() << " (" << pages_touched
+              << " first touch, " << sim->page_table->pageFaults() << " from swap)" << '\n';
+    std::cout << "Peak frames in use | " << run->peak_frames << " / " << sim->page_table->numFrames() << '\n';
+    std::cout << " PID  |   Accesses | Pages touched" << '\n';
+    std::cout << "------+------------+--------------" << '\n';
+    for (int i = 0; i < pids.size(); i++)
+    {
+        AccessProcess &process = run->processes[pids[i]];
+        std::cout << std::setw(5) << pids[i] << " | " << std::setw(10) << process.accesses << " | "
+                  << std::setw(13) << process.pages_touched << '\n';
+    }
+
+    if (sim->tlb != NULL)
+    {
+        sim->tlb->print();
+    }
+    if (sim->swap != NULL)
+    {
+        sim->page_table->printSwap();
+    }
+    if (sim->page_table->cache() != NULL)
+    {
+        sim->page_table->cache()->print();
+    }
+    if (sim->page_table->placement() != NULL)
+    {
+        sim->page_table->printPlacement();
+    }
+    if (sim->page_table->analyzer() != NULL)
+    {
+        sim->page_table->analyzer()->print();
+    }
+    if (sim->page_table->sweep() != NULL)
+    {
+        sim->page_table->sweep()->print();
+    }
+}
+
+long runAccessTrace(std::string path, Simulator *sim)
+{
+    AccessTraceReader reader;
+    if (!reader.open(path))
+    {
+        std::cout << "error: could not open access trace " << path << '\n';
+        return -1;
+    }
+
+    AccessTraceRun run;
+    run.sim = sim;
+    run.line_number = 0;
+    run.records = 0;
+    run.reads = 0;
+    run.writes = 0;
+    run.bytes = 0;
+    run.malformed = 0;
+    run.peak_frames = sim->page_table->framesInUse();
+
+    // A line split across two chunks is put back together in `carry`
+    std::string carry;
+    const char *data;
+    size_t length;
+    bool running = true;
+    while (running && reader.next(&data, &length))
+    {
+        const char *end = data + length;
+        const char *line = data;
+        if (!carry.empty())
+        {
+            const char *newline = (const char*)memchr(line, '\n', end - line);
+            if (newline == NULL)
+            {
+                carry.append(line, end);
+                continue;
+            }
+            carry.append(line, newline);
+            running = runRecord(&run, carry.data(), carry.data() + carry.size());
+            carry.clear();
+            line = newline + 1;
+        }
+        while (running && line < end)
+        {
+            const char *newline = (const char*)memchr(line, '\n', end - line);
+            if (newline == NULL)
+            {
+                carry.assign(line, end);
+                break;
+            }
+            running = runRecord(&run, line, newline);
+            line = newline + 1;
+        }
+    }
+    if (running && !carry.empty())
+    {
+        runRecord(&run, carry.data(), carry.data() + carry.size());
+    }
+    if (reader.failed())
+    {
+        std::cout << "error: could not read access trace " << path << '\n';
+        return -1;
+    }
+
+    printAccessSummary(&run);
+    return run.records;
+}
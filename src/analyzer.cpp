@@ -0,0 +1,333 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "analyzer.h"
+#include "pagetable.h"
+
+ReuseDistance::ReuseDistance()
+{
+    _used = 0;
+    _time = 0;
+}
+
+void ReuseDistance::add(uint32_t slot, int delta)
+{
+    for (uint32_t i = slot + 1; i < _tree.size(); i += i & -i)
+    {
+        _tree[i] += delta;
+    }
+}
+
+// Marks in slots [0, slots)
+uint32_t ReuseDistance::prefix(uint32_t slots)
+{
+    uint32_t sum = 0;
+    for (uint32_t i = slots; i > 0; i -= i & -i)
+    {
+        sum += _tree[i];
+    }
+    return sum;
+}
+
+// Moves the latest slot of every key to the front, in order, and leaves three
+// times as many free slots behind them, so compacting costs O(log n) per access
+void ReuseDistance::compact()
+{
+    std::vector<std::pair<uint32_t, uint64_t> > live;
+    live.reserve(_last.size());
+    std::unordered_map<uint64_t, uint32_t>::iterator it;
+    for (it = _last.begin(); it != _last.end(); it++)
+    {
+        live.push_back(std::make_pair(it->second, it->first));
+    }
+    std::sort(live.begin(), live.end());
+
+    uint32_t capacity = std::max<uint32_t>(4 * live.size(), 1024);
+    std::vector<uint64_t> times(capacity, 0);
+    for (uint32_t i = 0; i < live.size(); i++)
+    {
+        times[i] = _times[live[i].first];
+        _last[live[i].second] = i;
+    }
+    _times.swap(times);
+
+    // Build the tree bottom-up in linear time
+    _tree.assign(capacity + 1, 0);
+    for (uint32_t i = 1; i <= capacity; i++)
+    {
+        _tree[i] += (i <= live.size());
+        uint32_t parent = i + (i & -i);
+        if (parent <= capacity)
+        {
+            _tree[parent] += _tree[i];
+        }
+    }
+    _used = live.size();
+}
+
+// Returns the number of distinct keys accessed since the previous access to
+// `key`, or REUSE_COLD if this is the first
+uint64_t ReuseDistance::access(uint64_t key)
+{
+    if (_used == _times.size())
+    {
+        compact();
+    }
+
+    uint64_t distance = REUSE_COLD;
+    std::unordered_map<uint64_t, uint32_t>::iterator it = _last.find(key);
+    if (it != _last.end()) {
+        uint32_t slot = it->second;
+        distance = prefix(_used) - prefix(slot + 1);
+        add(slot, -1);
+        it->second = _used;
+    } else {
+        _last[key] = _used;
+    }
+    add(_used, 1);
+    _times[_used] = _time++;
+    _used++;
+    return distance;
+}
+
+// Forgets `key`, so it no longer counts towards any distance
+void ReuseDistance::remove(uint64_t key)
+{
+    std::unordered_map<uint64_t, uint32_t>::iterator it = _last.find(key);
+    if (it != _last.end())
+    {
+        add(it->second, -1);
+        _last.erase(it);
+    }
+}
+
+// Distinct keys whose latest access came at or after `time`
+uint32_t ReuseDistance::distinctSince(uint64_t time)
+{
+    uint32_t slot = std::lower_bound(_times.begin(), _times.begin() + _used, time) - _times.begin();
+    return prefix(_used) - prefix(slot);
+}
+
+uint32_t ReuseDistance::distinct()
+{
+    return _last.size();
+}
+
+// Accesses so far
+uint64_t ReuseDistance::time()
+{
+    return _time;
+}
+
+WorkingSetAnalyzer::WorkingSetAnalyzer(uint32_t page_size, uint64_t window)
+{
+    _page_size = page_size;
+    _window = window;
+    _cached_pid = 0;
+    _cached_process = NULL;
+}
+
+ProcessReuse* WorkingSetAnalyzer::process(uint32_t pid)
+{
+    if (_cached_process != NULL && _cached_pid == pid)
+    {
+        return _cached_process;
+    }
+
+    std::unordered_map<uint32_t, ProcessReuse>::iterator it = _processes.find(pid);
+    if (it == _processes.end())
+    {
+        ProcessReuse &process = _processes[pid];
+        process.exited = false;
+        process.accesses = 0;
+        process.cold = 0;
+        std::fill(process.histogram, process.histogram + REUSE_BUCKETS, 0);
+        process.working_set_total = 0;
+        process.working_set_peak = 0;
+        std::fill(process.footprint, process.footprint + ANALYZER_MAX_PAGE_BITS + 1, 0);
+        it = _processes.find(pid);
+    }
+    _cached_pid = pid;
+    _cached_process = &it->second;
+    return _cached_process;
+}
+
+// Records one access to a single page
+void WorkingSetAnalyzer::access(uint32_t pid, uint32_t virtual_address, uint32_t size)
+{
+    ProcessReuse *process = this->process(pid);
+    process->exited = false; // a process restored from a snapshot starts over
+    process->accesses++;
+
+    uint64_t distance = process->pages.access(virtual_address / _page_size);
+    if (distance == REUSE_COLD) {
+        process->cold++;
+    } else {
+        process->histogram[(distance == 0) ? 0 : 64 - __builtin_clzll(distance)]++;
+    }
+
+    uint64_t now = process->pages.time();
+    uint32_t working_set = (now > _window) ? process->pages.distinctSince(now - _window) : process->pages.distinct();
+    process->working_set_total += working_set;
+    process->working_set_peak = std::max(process->working_set_peak, working_set);
+
+    uint32_t last = (virtual_address + size - 1) >> ANALYZER_BLOCK_BITS;
+    for (uint32_t block = virtual_address >> ANALYZER_BLOCK_BITS; block <= last; block++)
+    {
+        uint32_t bitmap = block / ANALYZER_BITMAP_BLOCKS;
+        if (bitmap >= process->blocks.size())
+        {
+            process->blocks.resize(bitmap + 1);
+        }
+        if (process->blocks[bitmap].empty())
+        {
+            process->blocks[bitmap].assign(ANALYZER_BITMAP_BLOCKS / 64, 0);
+        }
+        uint32_t bit = block % ANALYZER_BITMAP_BLOCKS;
+        process->blocks[bitmap][bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+// Adds the pages the process's blocks fall on, at every page size, to `footprint`
+void WorkingSetAnalyzer::countFootprint(ProcessReuse *process, uint64_t *footprint)
+{
+    // Blocks come out in address order, so a page is new whenever it differs
+    // from the previous block's page at that size
+    uint64_t previous[ANALYZER_MAX_PAGE_BITS + 1];
+    std::fill(previous, previous + ANALYZER_MAX_PAGE_BITS + 1, UINT64_MAX);
+    for (uint32_t bitmap = 0; bitmap < process->blocks.size(); bitmap++)
+    {
+        std::vector<uint64_t> &words = process->blocks[bitmap];
+        for (uint32_t i = 0; i < words.size(); i++)
+        {
+            for (uint64_t word = words[i]; word != 0; word &= word - 1)
+            {
+                uint64_t block = (uint64_t)bitmap * ANALYZER_BITMAP_BLOCKS + i * 64 + __builtin_ctzll(word);
+                for (int bits = ANALYZER_BLOCK_BITS; bits <= ANALYZER_MAX_PAGE_BITS; bits++)
+                {
+                    uint64_t page = block >> (bits - ANALYZER_BLOCK_BITS);
+                    footprint[bits] += (page != previous[bits]);
+                    previous[bits] = page;
+                }
+            }
+        }
+    }
+}
+
+// Keeps the process's counts but drops what it took to compute them
+void WorkingSetAnalyzer::processExited(uint32_t pid)
+{
+    std::unordered_map<uint32_t, ProcessReuse>::iterator it = _processes.find(pid);
+    if (it == _processes.end() || it->second.exited)
+    {
+        return;
+    }
+    ProcessReuse &process = it->second;
+    countFootprint(&process, process.footprint);
+    process.pages = ReuseDistance();
+    std::vector<std::vector<uint64_t> >().swap(process.blocks);
+    process.exited = true;
+}
+
+void WorkingSetAnalyzer::print()
+{
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, ProcessReuse>::iterator it;
+    for (it = _processes.begin(); it != _processes.end(); it++)
+    {
+        pids.push_back(it->first);
+    }
+    std::sort(pids.begin(), pids.end());
+
+    uint64_t accesses = 0;
+    uint64_t cold = 0;
+    uint64_t histogram[REUSE_BUCKETS] = {0};
+    uint64_t footprint[ANALYZER_MAX_PAGE_BITS + 1] = {0};
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(1);
+
+    // Frames per process: LRU hits a reuse at distance d with more than d
+    // frames, so bucket b is covered by 2^b
+    std::cout << "Working set: last " << _window << " page accesses of each process, " << _page_size << "-byte pages" << '\n';
+    std::cout << " PID  |   Accesses |  Pages | Mean WS | Peak WS | Frames for 90% / 99% of reuses" << '\n';
+    std::cout << "------+------------+--------+---------+---------+-------------------------------" << '\n';
+    for (int p = 0; p < pids.size(); p++)
+    {
+        ProcessReuse &process = _processes[pids[p]];
+        accesses += process.accesses;
+        cold += process.cold;
+        for (int b = 0; b < REUSE_BUCKETS; b++)
+        {
+            histogram[b] += process.histogram[b];
+        }
+        for (int bits = 0; bits <= ANALYZER_MAX_PAGE_BITS; bits++)
+        {
+            footprint[bits] += process.footprint[bits];
+        }
+        if (!process.exited)
+        {
+            countFootprint(&process, footprint);
+        }
+
+        uint64_t reuses = process.accesses - process.cold;
+        uint64_t covered = 0;
+        int frames_90 = -1, frames_99 = -1;
+        for (int b = 0; b < REUSE_BUCKETS && reuses > 0; b++)
+        {
+            covered += process.histogram[b];
+            frames_90 = (frames_90 == -1 && covered * 10 >= reuses * 9) ? b : frames_90;
+            frames_99 = (frames_99 == -1 && covered * 100 >= reuses * 99) ? b : frames_99;
+        }
+        std::cout << std::setw(5) << pids[p] << " | " << std::setw(10) << process.accesses << " | " << std::setw(6) << process.cold << " | "
+                  << std::setw(7) << (double)process.working_set_total / std::max<uint64_t>(process.accesses, 1) << " | "
+                  << std::setw(7) << process.working_set_peak << " | ";
+        if (reuses == 0) {
+            std::cout << "no reuses" << '\n';
+        } else {
+            std::cout << (1ULL << frames_90) << " / " << (1ULL << frames_99) << '\n';
+        }
+    }
+
+    // Every row's hit rate counts first touches as misses
+    int last = 0;
+    for (int b = 0; b < REUSE_BUCKETS; b++)
+    {
+        last = (histogram[b] > 0) ? b : last;
+    }
+    std::cout << "Reuse distances (all processes)" << '\n';
+    std::cout << " Distance                |   Accesses | LRU hit rate with 2^b frames" << '\n';
+    std::cout << "-------------------------+------------+-----------------------------" << '\n';
+    std::cout << " first touch             | " << std::setw(10) << cold << " |" << '\n';
+    uint64_t hits = 0;
+    for (int b = 0; b <= last && accesses > cold; b++)
+    {
+        uint64_t low = (b == 0) ? 0 : 1ULL << (b - 1);
+        uint64_t high = (b == 0) ? 0 : (1ULL << b) - 1;
+        hits += histogram[b];
+        std::cout << ' ' << std::setw(10) << low << " - " << std::left << std::setw(10) << high << std::right << " | "
+                  << std::setw(10) << histogram[b] << " | " << std::setw(5) << 100.0 * hits / accesses << "% with "
+                  << (1ULL << b) << '\n';
+    }
+
+    // Smaller pages waste less of each page but need more page table entries
+    int smallest = ANALYZER_BLOCK_BITS;
+    for (int bits = ANALYZER_BLOCK_BITS; bits <= ANALYZER_MAX_PAGE_BITS; bits++)
+    {
+        uint64_t total = (footprint[bits] << bits) + footprint[bits] * sizeof(PageTableEntry);
+        uint64_t best = (footprint[smallest] << smallest) + footprint[smallest] * sizeof(PageTableEntry);
+        smallest = (total < best) ? bits : smallest;
+    }
+    std::cout << "Footprint by page size (all processes, page table entries at " << sizeof(PageTableEntry) << " bytes)" << '\n';
+    std::cout << " Page size |      Pages |       Bytes | Entry bytes |       Total" << '\n';
+    std::cout << "-----------+------------+-------------+-------------+------------" << '\n';
+    for (int bits = ANALYZER_BLOCK_BITS; bits <= ANALYZER_MAX_PAGE_BITS; bits++)
+    {
+        uint64_t bytes = footprint[bits] << bits;
+        uint64_t entry_bytes = footprint[bits] * sizeof(PageTableEntry);
+        std::cout << std::setw(10) << (1u << bits) << " | " << std::setw(10) << footprint[bits] << " | " << std::setw(11) << bytes << " | "
+                  << std::setw(11) << entry_bytes << " | " << std::setw(11) << bytes + entry_bytes
+                  << ((bits == smallest && accesses > 0) ? "  smallest" : "") << '\n';
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
@@ -0,0 +1,383 @@
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "binarytrace.h"
+
+TraceRecorder::TraceRecorder(std::string path)
+{
+    _file = fopen(path.c_str(), "wb");
+    if (_file != NULL)
+    {
+        setvbuf(_file, NULL, _IOFBF, 1 << 20);
+        uint32_t header[2] = {BINARY_TRACE_MAGIC, BINARY_TRACE_VERSION};
+        fwrite(header, sizeof(header), 1, _file);
+    }
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+    }
+}
+
+bool TraceRecorder::isOpen()
+{
+    return _file != NULL;
+}
+
+void TraceRecorder::beginRecord(TraceOpcode opcode)
+{
+    _record.clear();
+    _record.push_back(opcode);
+}
+
+void TraceRecorder::put32(uint32_t value)
+{
+    putBytes(&value, sizeof(value));
+}
+
+void TraceRecorder::putBytes(const void *data, uint32_t length)
+{
+    _record.insert(_record.end(), (const char*)data, (const char*)data + length);
+}
+
+void TraceRecorder::endRecord()
+{
+    fwrite(_record.data(), 1, _record.size(), _file);
+}
+
+uint32_t TraceRecorder::internName(const char *text, uint32_t length)
+{
+    std::string name(text, length);
+    std::unordered_map<std::string, uint32_t>::iterator it = _names.find(name);
+    if (it != _names.end())
+    {
+        return it->second;
+    }
+
+    // First use of a name: define it before the record that refers to it
+    uint32_t id = _names.size();
+    _names[name] = id;
+    beginRecord(TraceDefineName);
+    put32(id);
+    put32(length);
+    putBytes(text, length);
+    endRecord();
+    return id;
+}
+
+void TraceRecorder::recordText(std::vector<Token> &args)
+{
+    std::string line;
+    for (int i = 0; i < args.size(); i++)
+    {
+        if (i > 0)
+        {
+            line += ' ';
+        }
+        line.append(args[i].text, args[i].length);
+    }
+    beginRecord(TraceText);
+    put32(line.size());
+    putBytes(line.data(), line.size());
+    endRecord();
+}
+
+void TraceRecorder::record(std::vector<Token> &args, Simulator *sim)
+{
+    if (_file == NULL || args.size() == 0)
+    {
+        return;
+    }
+
+    // Numbers are stored the way the handlers convert them, so out of range
+    // values replay exactly as they ran. Anything that would only print an
+    // error is kept as text and replayed through the parser.
+    Token command = args[0];
+    long pid, first, second;
+    DataType type;
+    if (tokenEquals(command, "create") && args.size() >= 3 && parseLong(args[1], &first) && parseLong(args[2], &second))
+    {
+        beginRecord(TraceCreate);
+        put32(first);
+        put32(second);
+        endRecord();
+    }
+    else if (tokenEquals(command, "allocate") && args.size() >= 5 && parseDataType(args[3], &type) && parseLong(args[1], &pid) && parseLong(args[4], &first))
+    {
+        uint32_t name = internName(args[2].text, args[2].length);
+        beginRecord(TraceAllocate);
+        put32(pid);
+        put32(name);
+        _record.push_back(type);
+        put32(first);
+        endRecord();
+    }
+    else if (tokenEquals(command, "set") && args.size() >= 5 && parseLong(args[1], &pid) && parseLong(args[3], &first)
+             && first >= 0 && first <= UINT32_MAX && sim->mmu->getProcessAt(pid) != NULL)
+    {
+        Variable *var = sim->mmu->getVariableAt(pid, tokenString(args[2]));
+        uint32_t count = args.size() - 4;
+        std::vector<uint64_t> values(count);
+        Token invalid;
+        if (var == NULL || !parseValues(args, 4, var->type, values.data(), &invalid))
+        {
+            recordText(args);
+            return;
+        }
+
+        uint32_t name = internName(args[2].text, args[2].length);
+        beginRecord(TraceSet);
+        put32(pid);
+        put32(name);
+        put32(first);
+        _record.push_back(var->type);
+        put32(count);
+        putBytes(values.data(), count * getTypeByteSize(var->type));
+        endRecord();
+    }
+    else if (tokenEquals(command, "print") && args.size() >= 2 && memchr(args[1].text, ':', args[1].length) != NULL)
+    {
+        const char *colon = (const char*)memchr(args[1].text, ':', args[1].length);
+        Token pid_token = {args[1].text, (uint32_t)(colon - args[1].text)};
+        if (!parseLong(pid_token, &pid))
+        {
+            recordText(args);
+            return;
+        }
+        uint32_t name = internName(colon + 1, args[1].text + args[1].length - (colon + 1));
+        beginRecord(TracePrint);
+        put32(pid);
+        put32(name);
+        endRecord();
+    }
+    else if (tokenEquals(command, "free") && args.size() >= 3 && parseLong(args[1], &pid))
+    {
+        uint32_t name = internName(args[2].text, args[2].length);
+        beginRecord(TraceFree);
+        put32(pid);
+        put32(name);
+        endRecord();
+    }
+    else if (tokenEquals(command, "terminate") && args.size() >= 2 && parseLong(args[1], &pid))
+    {
+        beginRecord(TraceTerminate);
+        put32(pid);
+        endRecord();
+    }
+    else
+    {
+        recordText(args);
+    }
+}
+
+// Sliding read-only window over the trace. Only BINARY_TRACE_CHUNK bytes (or
+// one record, if larger) are mapped at a time, so traces may exceed RAM.
+typedef struct TraceReader {
+    int fd;
+    uint64_t file_size;
+    uint64_t position;
+    const char *map;
+    uint64_t map_offset;
+    uint64_t map_length;
+} TraceReader;
+
+// Returns the next `length` bytes and advances past them, or NULL at the end
+// of the file. The pointer is only valid until the next call.
+static const char* readBytes(TraceReader *reader, uint64_t length)
+{
+    if (reader->position + length > reader->file_size)
+    {
+        return NULL;
+    }
+
+    if (reader->map == NULL || reader->position + length > reader->map_offset + reader->map_length)
+    {
+        if (reader->map != NULL)
+        {
+            munmap((void*)reader->map, reader->map_length);
+        }
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        reader->map_offset = reader->position - reader->position % page;
+        reader->map_length = std::max<uint64_t>(BINARY_TRACE_CHUNK, reader->position + length - reader->map_offset);
+        reader->map_length = std::min<uint64_t>(reader->map_length, reader->file_size - reader->map_offset);
+        void *map = mmap(NULL, reader->map_length, PROT_READ, MAP_PRIVATE, reader->fd, reader->map_offset);
+        if (map == MAP_FAILED)
+        {
+            reader->map = NULL;
+            return NULL;
+        }
+        madvise(map, reader->map_length, MADV_SEQUENTIAL);
+        reader->map = (const char*)map;
+    }
+
+    const char *bytes = reader->map + (reader->position - reader->map_offset);
+    reader->position += length;
+    return bytes;
+}
+
+static bool read32(TraceReader *reader, uint32_t *value)
+{
+    const char *bytes = readBytes(reader, sizeof(*value));
+    if (bytes == NULL)
+    {
+        return false;
+    }
+    memcpy(value, bytes, sizeof(*value));
+    return true;
+}
+
+static bool read8(TraceReader *reader, uint8_t *value)
+{
+    const char *bytes = readBytes(reader, 1);
+    if (bytes == NULL)
+    {
+        return false;
+    }
+    *value = *bytes;
+    return true;
+}
+
+long runBinaryTrace(std::string path, Simulator *sim)
+{
+    TraceReader reader;
+    reader.fd = open(path.c_str(), O_RDONLY);
+    if (reader.fd == -1)
+    {
+        std::cout << "error: could not open trace " << path << '\n';
+        return -1;
+    }
+    struct stat info;
+    fstat(reader.fd, &info);
+    reader.file_size = info.st_size;
+    reader.position = 0;
+    reader.map = NULL;
+    reader.map_offset = 0;
+    reader.map_length = 0;
+
+    uint32_t magic, version;
+    if (!read32(&reader, &magic) || !read32(&reader, &version) || magic != BINARY_TRACE_MAGIC || version != BINARY_TRACE_VERSION)
+    {
+        std::cout << "error: " << path << " is not a binary trace" << '\n';
+        close(reader.fd);
+        return -1;
+    }
+
+    std::vector<std::string> names;
+    std::vector<Token> args;
+    long num_commands_run = 0;
+    bool running = true;
+    while (running && reader.position < reader.file_size)
+    {
+        uint8_t opcode, type;
+        uint32_t pid, name, first, second;
+        const char *bytes;
+        bool valid = read8(&reader, &opcode);
+        if (!valid)
+        {
+            break;
+        }
+
+        if (opcode == TraceDefineName)
+        {
+            valid = read32(&reader, &name) && read32(&reader, &first) && name == names.size() && (bytes = readBytes(&reader, first)) != NULL;
+            if (valid)
+            {
+                names.push_back(std::string(bytes, first));
+            }
+        }
+        else if (opcode == TraceCreate)
+        {
+            valid = read32(&reader, &first) && read32(&reader, &second);
+            if (valid)
+            {
+                createProcess((int)first, (int)second, sim->mmu, sim->page_table, sim->page_size);
+            }
+        }
+        else if (opcode == TraceAllocate)
+        {
+            valid = read32(&reader, &pid) && read32(&reader, &name) && read8(&reader, &type) && read32(&reader, &first) && name < names.size();
+            if (valid)
+            {
+                allocateVariable(pid, names[name], (DataType)type, first, sim->mmu, sim->page_table, sim->page_size);
+            }
+        }
+        else if (opcode == TraceSet)
+        {
+            valid = read32(&reader, &pid) && read32(&reader, &name) && read32(&reader, &first) && read8(&reader, &type)
+                 && read32(&reader, &second) && name < names.size()
+                 && (bytes = readBytes(&reader, (uint64_t)second * getTypeByteSize((DataType)type))) != NULL;
+            if (valid)
+            {
+                // Values are already packed in the variable's type, so they go straight to memory
+                Variable *var = sim->mmu->getVariableAt(pid, names[name]);
+                if (var == NULL) {
+                    simOut() << "error: variable not found\n";
+                } else if (var->type != type) {
+                    simOut() << "error: variable type differs from the recording\n";
+                } else {
+                    writeVariable(pid, var, first, (void*)bytes, second, sim->page_table, sim->memory, sim->page_size);
+                }
+            }
+        }
+        else if (opcode == TracePrint)
+        {
+            valid = read32(&reader, &pid) && read32(&reader, &name) && name < names.size();
+            if (valid)
+            {
+                printVariable(pid, names[name], sim->mmu, sim->page_table, sim->memory, sim->page_size);
+            }
+        }
+        else if (opcode == TraceFree)
+        {
+            valid = read32(&reader, &pid) && read32(&reader, &name) && name < names.size();
+            if (valid)
+            {
+                freeVariable(pid, names[name], sim->mmu, sim->page_table, sim->page_size);
+            }
+        }
+        else if (opcode == TraceTerminate)
+        {
+            valid = read32(&reader, &pid);
+            if (valid)
+            {
+                terminateProcess(pid, sim->mmu, sim->page_table, sim->page_size);
+            }
+        }
+        else if (opcode == TraceText)
+        {
+            valid = read32(&reader, &first) && (bytes = readBytes(&reader, first)) != NULL;
+            if (valid)
+            {
+                tokenize(bytes, bytes + first, args);
+                running = executeCommand(args, sim);
+            }
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            simOut() << "error: corrupt binary trace at byte " << reader.position << '\n';
+            break;
+        }
+        if (opcode != TraceDefineName)
+        {
+            num_commands_run++;
+        }
+    }
+
+    if (reader.map != NULL)
+    {
+        munmap((void*)reader.map, reader.map_length);
+    }
+    close(reader.fd);
+    return num_commands_run;
+}
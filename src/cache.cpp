@@ -0,0 +1,220 @@
+#include <iomanip>
+#include <algorithm>
+#include "cache.h"
+
+CacheHierarchy::CacheHierarchy()
+{
+    _cached_pid = 0;
+    _cached_counts = NULL;
+    _clock = 0;
+    _memory_reads = 0;
+    _memory_writes = 0;
+}
+
+CacheHierarchy::~CacheHierarchy()
+{
+}
+
+bool CacheHierarchy::parseWritePolicy(std::string name, bool *write_back)
+{
+    if (name == "writeback") {
+        *write_back = true;
+    } else if (name == "writethrough") {
+        *write_back = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Levels are added from L1 outward. The line size must be a power of two
+// and the size a whole number of sets of `ways` lines.
+bool CacheHierarchy::addLevel(uint64_t size, uint32_t line_size, uint32_t ways, bool write_back)
+{
+    if (_levels.size() == CACHE_MAX_LEVELS || line_size == 0 || (line_size & (line_size - 1)) != 0
+     || ways == 0 || size == 0 || size % ((uint64_t)line_size * ways) != 0)
+    {
+        return false;
+    }
+
+    CacheLevel level;
+    level.size = size;
+    level.line_size = line_size;
+    level.ways = ways;
+    level.num_sets = size / line_size / ways;
+    level.write_back = write_back;
+    CacheLine empty = {false, false, 0, 0};
+    level.lines.assign(size / line_size, empty);
+    level.hits = 0;
+    level.misses = 0;
+    level.writebacks = 0;
+    _levels.push_back(level);
+    return true;
+}
+
+uint32_t CacheHierarchy::numLevels()
+{
+    return _levels.size();
+}
+
+CacheCounts* CacheHierarchy::counts(uint32_t pid)
+{
+    // Accesses for the same process tend to arrive back to back
+    if (_cached_counts == NULL || _cached_pid != pid)
+    {
+        std::unordered_map<uint32_t, CacheCounts>::iterator it = _processes.find(pid);
+        if (it == _processes.end())
+        {
+            CacheCounts zero = {};
+            it = _processes.insert(std::make_pair(pid, zero)).first;
+        }
+        _cached_pid = pid;
+        _cached_counts = &it->second;
+    }
+    return _cached_counts;
+}
+
+void CacheHierarchy::access(uint32_t pid, uint64_t physical_address, uint32_t size, bool write)
+{
+    if (_levels.size() == 0 || size == 0)
+    {
+        return;
+    }
+
+    // One access per L1 line the bytes touch
+    CacheCounts *demand = counts(pid);
+    uint64_t line_size = _levels[0].line_size;
+    uint64_t first = physical_address / line_size;
+    uint64_t last = (physical_address + size - 1) / line_size;
+    for (uint64_t line = first; line <= last; line++)
+    {
+        accessLine(0, line * line_size, write, demand);
+    }
+}
+
+// Looks `address` up at `level`, going to the next level (or memory) on a
+// miss. Demand accesses, including stores passed on by a write-through
+// level, are counted against the process; dirty-victim writebacks from the
+// level above pass demand == NULL.
+void CacheHierarchy::accessLine(uint32_t level, uint64_t address, bool write, CacheCounts *demand)
+{
+    if (level == _levels.size())
+    {
+        if (write) {
+            _memory_writes++;
+        } else {
+            _memory_reads++;
+        }
+        return;
+    }
+
+    CacheLevel &cache = _levels[level];
+    uint64_t tag = address / cache.line_size;
+    CacheLine *ways = &cache.lines[(tag % cache.num_sets) * cache.ways];
+    _clock++;
+    for (int i = 0; i < cache.ways; i++)
+    {
+        if (ways[i].valid && ways[i].tag == tag)
+        {
+            ways[i].stamp = _clock;
+            if (demand != NULL)
+            {
+                cache.hits++;
+                demand->hits[level]++;
+            }
+            if (write && cache.write_back) {
+                ways[i].dirty = true;
+            } else if (write) {
+                // Write-through stores are demand traffic for the next level too
+                accessLine(level + 1, address, true, demand);
+            }
+            return;
+        }
+    }
+
+    if (demand != NULL)
+    {
+        cache.misses++;
+        demand->misses[level]++;
+    }
+    if (write && !cache.write_back)
+    {
+        // No write allocate: the write goes straight on
+        accessLine(level + 1, address, true, demand);
+        return;
+    }
+
+    // Fill from the next level into an empty way, or else the least recently used
+    accessLine(level + 1, address, false, demand);
+    CacheLine *victim = NULL;
+    for (int i = 0; i < cache.ways && victim == NULL; i++)
+    {
+        if (!ways[i].valid)
+        {
+            victim = &ways[i];
+        }
+    }
+    if (victim == NULL)
+    {
+        victim = &ways[0];
+        for (int i = 1; i < cache.ways; i++)
+        {
+            if (ways[i].stamp < victim->stamp)
+            {
+                victim = &ways[i];
+            }
+        }
+    }
+    if (victim->valid && victim->dirty)
+    {
+        cache.writebacks++;
+        accessLine(level + 1, victim->tag * cache.line_size, true, NULL);
+    }
+    victim->valid = true;
+    victim->dirty = write;
+    victim->tag = tag;
+    victim->stamp = _clock;
+}
+
+void CacheHierarchy::print()
+{
+    const char *names[CACHE_MAX_LEVELS] = {"L1", "L2", "LLC"};
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(2);
+    for (int i = 0; i < _levels.size(); i++)
+    {
+        CacheLevel &cache = _levels[i];
+        uint64_t accesses = cache.hits + cache.misses;
+        std::cout << names[i] << ": " << cache.size << " bytes, " << cache.line_size << "-byte lines, " << cache.ways << "-way, "
+                  << (cache.write_back ? "write-back" : "write-through") << '\n';
+        std::cout << "  Accesses   | " << accesses << '\n';
+        std::cout << "  Hits       | " << cache.hits << '\n';
+        std::cout << "  Misses     | " << cache.misses << '\n';
+        std::cout << "  Hit rate   | " << ((accesses > 0) ? 100.0 * cache.hits / accesses : 0.0) << "%" << '\n';
+        std::cout << "  Writebacks | " << cache.writebacks << '\n';
+    }
+    std::cout << "Memory: " << _memory_reads << " line reads, " << _memory_writes << " line writes" << '\n';
+
+    // Per-process demand hit rates, ordered by pid
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, CacheCounts>::iterator it;
+    for (it = _processes.begin(); it != _processes.end(); it++)
+    {
+        pids.push_back(it->first);
+    }
+    std::sort(pids.begin(), pids.end());
+    std::cout << " PID  | Level |   Accesses |     Misses | Hit rate" << '\n';
+    std::cout << "------+-------+------------+------------+---------" << '\n';
+    for (int p = 0; p < pids.size(); p++)
+    {
+        CacheCounts &counts = _processes[pids[p]];
+        for (int i = 0; i < _levels.size(); i++)
+        {
+            uint64_t accesses = counts.hits[i] + counts.misses[i];
+            std::cout << std::setw(5) << pids[p] << " | " << std::setw(5) << names[i] << " | " << std::setw(10) << accesses << " | "
+                      << std::setw(10) << counts.misses[i] << " | " << std::setw(7) << ((accesses > 0) ? 100.0 * counts.hits[i] / accesses : 0.0) << "%" << '\n';
+        }
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
@@ -0,0 +1,531 @@
+#include <cstring>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "command.h"
+#include "binarytrace.h"
+#include "stats.h"
+
+static void handleCreate(std::vector<Token> &args, Simulator *sim);
+static void handleAllocate(std::vector<Token> &args, Simulator *sim);
+static void handleSet(std::vector<Token> &args, Simulator *sim);
+static void handlePrint(std::vector<Token> &args, Simulator *sim);
+static void handleFree(std::vector<Token> &args, Simulator *sim);
+static void handleTerminate(std::vector<Token> &args, Simulator *sim);
+static void handleFork(std::vector<Token> &args, Simulator *sim);
+static void handleSnapshot(std::vector<Token> &args, Simulator *sim);
+static void handleRestore(std::vector<Token> &args, Simulator *sim);
+
+// Command name, minimum number of tokens including the name, handler
+static const Command commands[] = {
+    {"create", 3, handleCreate},
+    {"allocate", 5, handleAllocate},
+    {"set", 5, handleSet},
+    {"print", 2, handlePrint},
+    {"free", 3, handleFree},
+    {"terminate", 2, handleTerminate},
+    {"fork", 2, handleFork},
+    {"snapshot", 2, handleSnapshot},
+    {"restore", 2, handleRestore},
+};
+static const int num_commands = sizeof(commands) / sizeof(commands[0]);
+
+void tokenize(const char *line, const char *end, std::vector<Token> &tokens)
+{
+    tokens.clear();
+    const char *p = line;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            p++;
+        }
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        {
+            p++;
+        }
+        if (p > start)
+        {
+            Token token = {start, (uint32_t)(p - start)};
+            tokens.push_back(token);
+        }
+    }
+}
+
+bool tokenEquals(Token token, const char *text)
+{
+    return strlen(text) == token.length && memcmp(token.text, text, token.length) == 0;
+}
+
+std::string tokenString(Token token)
+{
+    return std::string(token.text, token.length);
+}
+
+bool parseLong(Token token, long *value)
+{
+    uint32_t i = 0;
+    bool negative = false;
+    if (token.length > 0 && (token.text[0] == '-' || token.text[0] == '+'))
+    {
+        negative = (token.text[0] == '-');
+        i++;
+    }
+    if (i == token.length)
+    {
+        return false;
+    }
+
+    long result = 0;
+    for (; i < token.length; i++)
+    {
+        if (token.text[i] < '0' || token.text[i] > '9')
+        {
+            return false;
+        }
+        result = result * 10 + (token.text[i] - '0');
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+// Plain decimals such as "-12.25" with at most 15 significant digits are exact
+// as mantissa / 10^k, so they skip strtod; anything else falls through to it
+static bool parseSimpleDecimal(Token token, double *value)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    uint32_t i = 0;
+    bool negative = false;
+    if (token.length > 0 && (token.text[0] == '-' || token.text[0] == '+'))
+    {
+        negative = (token.text[0] == '-');
+        i++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fraction_digits = -1; // -1 until the decimal point is seen
+    for (; i < token.length; i++)
+    {
+        char c = token.text[i];
+        if (c == '.' && fraction_digits < 0)
+        {
+            fraction_digits = 0;
+            continue;
+        }
+        if (c < '0' || c > '9' || digits == 15)
+        {
+            return false;
+        }
+        mantissa = mantissa * 10 + (c - '0');
+        digits++;
+        if (fraction_digits >= 0)
+        {
+            fraction_digits++;
+        }
+    }
+    if (digits == 0)
+    {
+        return false;
+    }
+
+    double result = (double)mantissa;
+    if (fraction_digits > 0)
+    {
+        result /= powers[fraction_digits];
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+bool parseDouble(Token token, double *value)
+{
+    if (parseSimpleDecimal(token, value))
+    {
+        return true;
+    }
+
+    // strtod needs a terminated string and tokens point into the input buffer
+    char buffer[64];
+    if (token.length == 0 || token.length >= sizeof(buffer))
+    {
+        return false;
+    }
+    memcpy(buffer, token.text, token.length);
+    buffer[token.length] = '\0';
+
+    char *end;
+    *value = strtod(buffer, &end);
+    return end == buffer + token.length;
+}
+
+bool parseDataType(Token token, DataType *type)
+{
+    //FreeSpace, Char, Short, Int, Float, Long, Double
+    if (tokenEquals(token, "freespace")) {
+        *type = FreeSpace;
+    } else if (tokenEquals(token, "char")) {
+        *type = Char;
+    } else if (tokenEquals(token, "short")) {
+        *type = Short;
+    } else if (tokenEquals(token, "int")) {
+        *type = Int;
+    } else if (tokenEquals(token, "float")) {
+        *type = Float;
+    } else if (tokenEquals(token, "long")) {
+        *type = Long;
+    } else if (tokenEquals(token, "double")) {
+        *type = Double;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool executeCommand(std::vector<Token> &args, Simulator *sim)
+{
+    if (args.size() == 0)
+    {
+        return true;
+    }
+    if (sim->recorder != NULL)
+    {
+        sim->recorder->record(args, sim);
+    }
+    if (tokenEquals(args[0], "exit"))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < num_commands; i++)
+    {
+        if (tokenEquals(args[0], commands[i].name))
+        {
+            if (args.size() < commands[i].min_args)
+            {
+                simOut() << "error: too few arguments for " << commands[i].name << '\n';
+            }
+            else
+            {
+                commands[i].handler(args, sim);
+            }
+            return true;
+        }
+    }
+
+    simOut() << "command recieved was: " << tokenString(args[0]) << '\n';
+    simOut() << "error: command not recognized" << '\n';
+    return true;
+}
+
+bool mapTrace(std::string path, const char **data, size_t *size)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        std::cout << "error: could not open trace " << path << '\n';
+        return false;
+    }
+
+    struct stat info;
+    fstat(fd, &info);
+    *data = NULL;
+    *size = info.st_size;
+    if (info.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    *data = (const char*)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (*data == MAP_FAILED)
+    {
+        std::cout << "error: could not map trace " << path << '\n';
+        return false;
+    }
+    madvise((void*)*data, info.st_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+long runTrace(std::string path, Simulator *sim)
+{
+    const char *data;
+    size_t size;
+    if (!mapTrace(path, &data, &size))
+    {
+        return -1;
+    }
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    // Tokens point straight into the mapping, so the vector is the only buffer
+    std::vector<Token> args;
+    long num_commands_run = 0;
+    const char *end = data + size;
+    const char *line = data;
+    while (line < end)
+    {
+        const char *newline = (const char*)memchr(line, '\n', end - line);
+        const char *line_end = (newline != NULL) ? newline : end;
+
+        tokenize(line, line_end, args);
+        if (args.size() > 0 && args[0].text[0] != '#')
+        {
+            num_commands_run++;
+            if (!executeCommand(args, sim))
+            {
+                break;
+            }
+        }
+        line = line_end + 1;
+    }
+
+    munmap((void*)data, size);
+    return num_commands_run;
+}
+
+long runWorkload(WorkloadGenerator *generator, Simulator *sim)
+{
+    std::string line;
+    std::vector<Token> args;
+    long num_commands_run = 0;
+    while (generator->next(line))
+    {
+        tokenize(line.data(), line.data() + line.size(), args);
+        num_commands_run++;
+        executeCommand(args, sim);
+    }
+    return num_commands_run;
+}
+
+static void handleCreate(std::vector<Token> &args, Simulator *sim)
+{
+    long text_size, data_size;
+    if (!parseLong(args[1], &text_size) || !parseLong(args[2], &data_size))
+    {
+        simOut() << "error: invalid size" << '\n';
+        return;
+    }
+
+    //Initialize new process, print PID
+    createProcess(text_size, data_size, sim->mmu, sim->page_table, sim->page_size);
+}
+
+static void handleAllocate(std::vector<Token> &args, Simulator *sim)
+{
+    long pid, num_elements;
+    DataType type;
+    if (!parseDataType(args[3], &type))
+    {
+        simOut() << "error: illegal type" << '\n';
+        return;
+    }
+    if (!parseLong(args[1], &pid) || !parseLong(args[4], &num_elements))
+    {
+        simOut() << "error: invalid number" << '\n';
+        return;
+    }
+
+    allocateVariable(pid, tokenString(args[2]), type, num_elements, sim->mmu, sim->page_table, sim->page_size);
+}
+
+// Parses args[first..] into a packed array of T using the given number parser
+template <typename T, typename Parsed>
+static bool convertValues(std::vector<Token> &args, uint32_t first, T *out, bool (*parse)(Token, Parsed*), Token *invalid)
+{
+    for (uint32_t i = first; i < args.size(); i++)
+    {
+        Parsed value;
+        if (!parse(args[i], &value))
+        {
+            *invalid = args[i];
+            return false;
+        }
+        out[i - first] = value;
+    }
+    return true;
+}
+
+static bool convertChars(std::vector<Token> &args, uint32_t first, char *out)
+{
+    for (uint32_t i = first; i < args.size(); i++)
+    {
+        out[i - first] = args[i].text[0];
+    }
+    return true;
+}
+
+bool parseValues(std::vector<Token> &args, uint32_t first, DataType type, void *out, Token *invalid)
+{
+    // The type is dispatched once so each conversion loop runs over a single element type
+    *invalid = args[first];
+    if (type == Char) {
+        return convertChars(args, first, (char*)out);
+    } else if (type == Short) {
+        return convertValues(args, first, (short*)out, parseLong, invalid);
+    } else if (type == Int) {
+        return convertValues(args, first, (int*)out, parseLong, invalid);
+    } else if (type == Float) {
+        return convertValues(args, first, (float*)out, parseDouble, invalid);
+    } else if (type == Long) {
+        return convertValues(args, first, (long*)out, parseLong, invalid);
+    } else if (type == Double) {
+        return convertValues(args, first, (double*)out, parseDouble, invalid);
+    }
+    return false;
+}
+
+//"  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)"
+static void handleSet(std::vector<Token> &args, Simulator *sim)
+{
+    long pid, offset;
+    if (!parseLong(args[1], &pid) || !parseLong(args[3], &offset))
+    {
+        simOut() << "error: invalid number" << '\n';
+        return;
+    }
+    if (offset < 0 || offset > UINT32_MAX)
+    {
+        simOut() << "error: index out of range" << '\n';
+        return;
+    }
+
+    Variable *inq = sim->mmu->getVariableAt(pid, tokenString(args[2])); //resolve the variable once for every value
+    if (inq == NULL)
+    {
+        simOut() << "error: variable not found\n"; //getVariableAt returns null if it threw an error. 
+        return;
+    }
+
+    // Convert every value up front so the write happens in one pass
+    uint32_t num_values = args.size() - 4;
+    std::vector<uint64_t> buffer(num_values);
+    Token invalid;
+    if (!parseValues(args, 4, inq->type, buffer.data(), &invalid))
+    {
+        simOut() << "error: invalid value " << tokenString(invalid) << '\n';
+        return;
+    }
+
+    writeVariable(pid, inq, offset, buffer.data(), num_values, sim->page_table, sim->memory, sim->page_size);
+}
+
+static void handlePrint(std::vector<Token> &args, Simulator *sim)
+{
+    Token object = args[1];
+    if (tokenEquals(object, "mmu")) {
+        sim->mmu->print();
+    } else if (tokenEquals(object, "page")) {
+        sim->page_table->print();
+    } else if (tokenEquals(object, "processes")) {
+        sim->mmu->printProcesses();
+    } else if (tokenEquals(object, "heap")) {
+        sim->mmu->printHeap();
+    } else if (tokenEquals(object, "memory")) {
+        sim->mmu->printFootprint();
+    } else if (tokenEquals(object, "stats")) {
+        printStats(std::cout, sim->mmu, sim->page_table);
+    } else if (tokenEquals(object, "cache")) {
+        if (sim->page_table->cache() == NULL) {
+            simOut() << "error: no cache configured (start with --cache <size> <line_size> <ways> <writeback|writethrough>)\n";
+        } else {
+            sim->page_table->cache()->print();
+        }
+    } else if (tokenEquals(object, "workingset")) {
+        if (sim->page_table->analyzer() == NULL) {
+            simOut() << "error: no working-set analysis (start with --analyze <window>)\n";
+        } else {
+            sim->page_table->analyzer()->print();
+        }
+    } else if (tokenEquals(object, "sweep")) {
+        if (sim->page_table->sweep() == NULL) {
+            simOut() << "error: no sweep configured (start with --sweep <page_size>,<page_size>,...)\n";
+        } else {
+            sim->page_table->sweep()->print();
+        }
+    } else if (tokenEquals(object, "placement")) {
+        if (sim->page_table->placement() == NULL) {
+            simOut() << "error: no placement policy (start with --placement <policy> <count>)\n";
+        } else {
+            sim->page_table->printPlacement();
+        }
+    } else if (tokenEquals(object, "swap")) {
+        if (sim->swap == NULL) {
+            simOut() << "error: swap not enabled (start with --swap <file> <policy>)\n";
+        } else {
+            sim->page_table->printSwap();
+        }
+    } else if (tokenEquals(object, "largepages")) {
+        if (sim->page_table->largePageFactor() <= 1) {
+            simOut() << "error: large pages not enabled (start with --large-pages <bytes>)\n";
+        } else {
+            sim->page_table->printLargePages();
+        }
+    } else if (tokenEquals(object, "tlb")) {
+        if (sim->tlb == NULL) {
+            simOut() << "error: no TLB configured (start with --tlb <entries> <ways> <policy>)\n";
+        } else {
+            sim->tlb->print();
+        }
+    } else {
+        //split argument by colon
+        const char *colon = (const char*)memchr(object.text, ':', object.length);
+        Token pid_token = {object.text, (colon != NULL) ? (uint32_t)(colon - object.text) : 0};
+        long pid;
+        if (colon == NULL || !parseLong(pid_token, &pid)) {
+            simOut() << "error: illegal print argument\n";
+        } else {
+            std::string var_name(colon + 1, object.text + object.length);
+            printVariable(pid, var_name, sim->mmu, sim->page_table, sim->memory, sim->page_size);
+        }
+    }
+}
+
+static void handleFree(std::vector<Token> &args, Simulator *sim)
+{
+    long pid;
+    if (!parseLong(args[1], &pid))
+    {
+        simOut() << "error: invalid number" << '\n';
+        return;
+    }
+    freeVariable(pid, tokenString(args[2]), sim->mmu, sim->page_table, sim->page_size);
+}
+
+static void handleTerminate(std::vector<Token> &args, Simulator *sim)
+{
+    long pid;
+    if (!parseLong(args[1], &pid))
+    {
+        simOut() << "error: invalid number" << '\n';
+        return;
+    }
+    terminateProcess(pid, sim->mmu, sim->page_table, sim->page_size);
+}
+
+static void handleFork(std::vector<Token> &args, Simulator *sim)
+{
+    long pid;
+    if (!parseLong(args[1], &pid))
+    {
+        simOut() << "error: invalid number" << '\n';
+        return;
+    }
+    forkProcess(pid, sim->mmu, sim->page_table);
+}
+
+static void handleSnapshot(std::vector<Token> &args, Simulator *sim)
+{
+    saveSnapshot(tokenString(args[1]), sim);
+}
+
+static void handleRestore(std::vector<Token> &args, Simulator *sim)
+{
+    restoreSnapshot(tokenString(args[1]), sim);
+}
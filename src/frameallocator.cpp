@@ -0,0 +1,282 @@
+#include <algorithm>
+#include "frameallocator.h"
+
+FrameAllocator::FrameAllocator(uint32_t num_frames)
+{
+    _num_frames = num_frames;
+    _num_free = 0;
+    _num_shared = 0;
+    _refs.assign(num_frames, 0);
+
+    // Size every level so the top level fits in a single word
+    uint32_t bits = num_frames;
+    do
+    {
+        uint32_t words = (bits + 63) / 64;
+        _levels.push_back(std::vector<uint64_t>(words, 0));
+        bits = words;
+    } while (bits > 1);
+
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        setFree(i);
+    }
+}
+
+FrameAllocator::~FrameAllocator()
+{
+}
+
+void FrameAllocator::setFree(uint32_t frame)
+{
+    uint32_t index = frame;
+    for (int level = 0; level < _levels.size(); level++)
+    {
+        uint64_t &word = _levels[level][index / 64];
+        bool was_empty = (word == 0);
+        word |= 1ULL << (index % 64);
+        if (!was_empty)
+        {
+            break; // parent levels already know this word has a free frame
+        }
+        index /= 64;
+    }
+    _num_free++;
+}
+
+void FrameAllocator::clearFree(uint32_t frame)
+{
+    uint32_t index = frame;
+    for (int level = 0; level < _levels.size(); level++)
+    {
+        uint64_t &word = _levels[level][index / 64];
+        word &= ~(1ULL << (index % 64));
+        if (word != 0)
+        {
+            break; // word still has a free frame, so parents are unchanged
+        }
+        index /= 64;
+    }
+    _refs[frame] = 1;
+    _num_free--;
+}
+
+int FrameAllocator::allocate()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_num_free == 0)
+    {
+        return -1;
+    }
+
+    // Walk down from the top level, always taking the lowest set bit
+    uint32_t index = 0;
+    for (int level = _levels.size() - 1; level >= 0; level--)
+    {
+        index = index * 64 + __builtin_ctzll(_levels[level][index]);
+    }
+
+    clearFree(index);
+    return index;
+}
+
+// Lowest index at or after `from` whose bit is set in `level`, or -1. A
+// word with nothing set is skipped by asking the level above for the next
+// word that has a bit set.
+int64_t FrameAllocator::findFrom(int level, uint64_t from)
+{
+    std::vector<uint64_t> &bits = _levels[level];
+    uint64_t word = from / 64;
+    if (word >= bits.size())
+    {
+        return -1;
+    }
+    uint64_t rest = bits[word] & (~0ULL << (from % 64));
+    if (rest != 0)
+    {
+        return word * 64 + __builtin_ctzll(rest);
+    }
+    if (level + 1 == _levels.size())
+    {
+        return -1;
+    }
+    int64_t next = findFrom(level + 1, word + 1);
+    return (next == -1) ? -1 : next * 64 + __builtin_ctzll(bits[next]);
+}
+
+// Claims the lowest free frame in [first, end) whose number is congruent to
+// `offset` modulo `stride`, a power of two. Words without a free frame are
+// skipped through level 1, so a full region costs one probe per 4096 frames.
+int FrameAllocator::allocateIn(uint32_t first, uint32_t end, uint32_t stride, uint32_t offset)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    end = std::min(end, _num_frames);
+    if (first >= end)
+    {
+        return -1;
+    }
+
+    // Frames of the right residue within a word, when a stride fits in a word
+    uint64_t pattern = 0;
+    for (uint32_t bit = offset % stride; stride <= 64 && bit < 64; bit += stride)
+    {
+        pattern |= 1ULL << bit;
+    }
+
+    int64_t word = first / 64;
+    while (word != -1 && (uint64_t)word * 64 < end)
+    {
+        uint64_t bits = _levels[0][word];
+        if (stride <= 64) {
+            bits &= pattern;
+        } else {
+            bits &= (word % (stride / 64) == offset / 64) ? 1ULL << (offset % 64) : 0;
+        }
+        if (word == first / 64)
+        {
+            bits &= ~0ULL << (first % 64);
+        }
+        if (bits != 0)
+        {
+            uint32_t frame = word * 64 + __builtin_ctzll(bits);
+            if (frame >= end)
+            {
+                return -1;
+            }
+            clearFree(frame);
+            return frame;
+        }
+        word = (_levels.size() > 1) ? findFrom(1, word + 1) : -1;
+    }
+    return -1;
+}
+
+void FrameAllocator::release(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (frame < 0 || frame >= _num_frames || isFree(frame))
+    {
+        return;
+    }
+    if (_refs[frame] > 1)
+    {
+        _num_shared -= (--_refs[frame] == 1);
+        return;
+    }
+    _refs[frame] = 0;
+    setFree(frame);
+}
+
+// Claims `count` contiguous frames aligned to `count`, which must be a power
+// of two. Large pages are rare, so level 0 is simply scanned for a free run.
+int FrameAllocator::allocateRun(uint32_t count)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    std::vector<uint64_t> &bits = _levels[0];
+    int first = -1;
+    if (count <= 64)
+    {
+        uint64_t mask = (count == 64) ? ~0ULL : (1ULL << count) - 1;
+        for (uint32_t word = 0; word < bits.size() && first == -1; word++)
+        {
+            for (uint32_t shift = 0; shift < 64 && bits[word] != 0; shift += count)
+            {
+                if (((bits[word] >> shift) & mask) == mask)
+                {
+                    first = word * 64 + shift;
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        // Runs of whole words; bits past the last frame are never set
+        uint32_t words = count / 64;
+        for (uint32_t word = 0; word + words <= bits.size() && first == -1; word += words)
+        {
+            uint32_t full = 0;
+            while (full < words && bits[word + full] == ~0ULL)
+            {
+                full++;
+            }
+            if (full == words)
+            {
+                first = word * 64;
+            }
+        }
+    }
+
+    if (first != -1)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            clearFree(first + i);
+        }
+    }
+    return first;
+}
+
+// A shared run is counted through its first frame, like share() of a large page
+void FrameAllocator::releaseRun(int first, uint32_t count)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (first >= 0 && first < _num_frames && _refs[first] > 1)
+    {
+        _num_shared -= (--_refs[first] == 1);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (first + i < _num_frames && !isFree(first + i))
+        {
+            _refs[first + i] = 0;
+            setFree(first + i);
+        }
+    }
+}
+
+// Takes a specific free frame, as when a saved mapping is restored
+bool FrameAllocator::claim(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (frame < 0 || frame >= _num_frames || !isFree(frame))
+    {
+        return false;
+    }
+    clearFree(frame);
+    return true;
+}
+
+void FrameAllocator::share(int frame)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _num_shared += (++_refs[frame] == 2);
+}
+
+// Read without the lock: a frame is only shared between page tables of the
+// same shard, so its count never changes under another thread
+uint32_t FrameAllocator::refCount(int frame)
+{
+    return _refs[frame];
+}
+
+bool FrameAllocator::isFree(int frame)
+{
+    return (_levels[0][frame / 64] >> (frame % 64)) & 1;
+}
+
+uint32_t FrameAllocator::numFrames()
+{
+    return _num_frames;
+}
+
+uint32_t FrameAllocator::numFree()
+{
+    return _num_free;
+}
+
+uint32_t FrameAllocator::numShared()
+{
+    return _num_shared;
+}
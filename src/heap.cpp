@@ -0,0 +1,557 @@
+#include <algorithm>
+#include "heap.h"
+#include "snapshot.h"
+
+Heap::Heap(uint32_t size, HeapPolicy policy)
+{
+    _policy = policy;
+    _size = size;
+    _root = NULL;
+    _rand_state = 2463534242u;
+    _next_fit = 0;
+    _internal_waste = 0;
+    _merges = 0;
+
+    if (_policy == Buddy)
+    {
+        // The buddy arena is the largest power of two that fits
+        uint32_t order = 31 - __builtin_clz(size);
+        _size = 1u << order;
+        _buddy_free[order].insert(0);
+    }
+    else
+    {
+        insertBlock(0, size);
+    }
+}
+
+Heap::~Heap()
+{
+    destroy(_root);
+}
+
+bool Heap::parsePolicy(std::string name, HeapPolicy *policy)
+{
+    if (name == "first") {
+        *policy = FirstFit;
+    } else if (name == "best") {
+        *policy = BestFit;
+    } else if (name == "next") {
+        *policy = NextFit;
+    } else if (name == "buddy") {
+        *policy = Buddy;
+    } else if (name == "segregated") {
+        *policy = Segregated;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* Heap::policyName(HeapPolicy policy)
+{
+    const char *names[] = {"first-fit", "best-fit", "next-fit", "buddy", "segregated"};
+    return names[policy];
+}
+
+HeapPolicy Heap::policy()
+{
+    return _policy;
+}
+
+uint32_t Heap::sizeClass(uint32_t size)
+{
+    return 31 - __builtin_clz(size);
+}
+
+uint32_t Heap::buddyOrder(uint32_t size)
+{
+    uint32_t order = (size <= 1) ? 0 : 32 - __builtin_clz(size - 1);
+    return (order < HEAP_BUDDY_MIN_ORDER) ? HEAP_BUDDY_MIN_ORDER : order;
+}
+
+void Heap::update(FreeBlock *node)
+{
+    node->max_size = node->size;
+    if (node->left != NULL && node->left->max_size > node->max_size)
+    {
+        node->max_size = node->left->max_size;
+    }
+    if (node->right != NULL && node->right->max_size > node->max_size)
+    {
+        node->max_size = node->right->max_size;
+    }
+}
+
+void Heap::split(FreeBlock *node, uint32_t address, FreeBlock **left, FreeBlock **right)
+{
+    // left receives blocks below address, right the rest
+    if (node == NULL)
+    {
+        *left = NULL;
+        *right = NULL;
+    }
+    else if (node->address < address)
+    {
+        split(node->right, address, &node->right, right);
+        *left = node;
+        update(node);
+    }
+    else
+    {
+        split(node->left, address, left, &node->left);
+        *right = node;
+        update(node);
+    }
+}
+
+FreeBlock* Heap::join(FreeBlock *left, FreeBlock *right)
+{
+    if (left == NULL)
+    {
+        return right;
+    }
+    if (right == NULL)
+    {
+        return left;
+    }
+
+    if (left->priority > right->priority)
+    {
+        left->right = join(left->right, right);
+        update(left);
+        return left;
+    }
+    right->left = join(left, right->left);
+    update(right);
+    return right;
+}
+
+FreeBlock* Heap::firstFit(FreeBlock *node, uint32_t from, uint32_t size)
+{
+    // Lowest-addressed block at or after `from` holding at least `size` bytes
+    if (node == NULL || node->max_size < size)
+    {
+        return NULL;
+    }
+    if (node->address < from)
+    {
+        return firstFit(node->right, from, size);
+    }
+
+    FreeBlock *found = firstFit(node->left, from, size);
+    if (found != NULL)
+    {
+        return found;
+    }
+    if (node->size >= size)
+    {
+        return node;
+    }
+    return firstFit(node->right, from, size);
+}
+
+void Heap::destroy(FreeBlock *node)
+{
+    if (node != NULL)
+    {
+        destroy(node->left);
+        destroy(node->right);
+        delete node;
+    }
+}
+
+void Heap::collect(FreeBlock *node, std::vector<FreeBlock*> &blocks)
+{
+    if (node != NULL)
+    {
+        collect(node->left, blocks);
+        blocks.push_back(node);
+        collect(node->right, blocks);
+    }
+}
+
+FreeBlock* Heap::find(uint32_t address)
+{
+    FreeBlock *node = _root;
+    while (node != NULL && node->address != address)
+    {
+        node = (address < node->address) ? node->left : node->right;
+    }
+    return node;
+}
+
+FreeBlock* Heap::predecessor(uint32_t address)
+{
+    FreeBlock *node = _root;
+    FreeBlock *best = NULL;
+    while (node != NULL)
+    {
+        if (node->address < address) {
+            best = node;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return best;
+}
+
+FreeBlock* Heap::successor(uint32_t address)
+{
+    FreeBlock *node = _root;
+    FreeBlock *best = NULL;
+    while (node != NULL)
+    {
+        if (node->address > address) {
+            best = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+void Heap::insertBlock(uint32_t address, uint32_t size)
+{
+    // xorshift32 priorities keep the treap balanced in expectation
+    _rand_state ^= _rand_state << 13;
+    _rand_state ^= _rand_state >> 17;
+    _rand_state ^= _rand_state << 5;
+
+    FreeBlock *node = new FreeBlock();
+    node->address = address;
+    node->size = size;
+    node->priority = _rand_state;
+    node->max_size = size;
+    node->left = NULL;
+    node->right = NULL;
+
+    FreeBlock *left, *right;
+    split(_root, address, &left, &right);
+    _root = join(join(left, node), right);
+
+    _by_size.insert(std::make_pair(size, address));
+    _classes[sizeClass(size)].insert(address);
+}
+
+void Heap::eraseBlock(uint32_t address)
+{
+    FreeBlock *left, *middle, *right;
+    split(_root, address, &left, &right);
+    split(right, address + 1, &middle, &right);
+    _root = join(left, right);
+
+    if (middle != NULL)
+    {
+        _by_size.erase(std::make_pair(middle->size, middle->address));
+        _classes[sizeClass(middle->size)].erase(middle->address);
+        delete middle;
+    }
+}
+
+void Heap::carve(FreeBlock *block, uint32_t size)
+{
+    // Allocations come from the front of the chosen block
+    uint32_t address = block->address;
+    uint32_t remaining = block->size - size;
+    eraseBlock(address);
+    if (remaining > 0)
+    {
+        insertBlock(address + size, remaining);
+    }
+}
+
+bool Heap::allocate(uint32_t size, uint32_t *address)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+    if (_policy == Buddy)
+    {
+        return allocateBuddy(size, address);
+    }
+
+    FreeBlock *block = NULL;
+    if (_policy == FirstFit)
+    {
+        block = firstFit(_root, 0, size);
+    }
+    else if (_policy == NextFit)
+    {
+        // Resume from where the last allocation ended, wrapping once
+        block = firstFit(_root, _next_fit, size);
+        if (block == NULL)
+        {
+            block = firstFit(_root, 0, size);
+        }
+    }
+    else if (_policy == BestFit)
+    {
+        std::set<std::pair<uint32_t, uint32_t> >::iterator it = _by_size.lower_bound(std::make_pair(size, 0u));
+        if (it != _by_size.end())
+        {
+            block = find(it->second);
+        }
+    }
+    else if (_policy == Segregated)
+    {
+        // Every block in a class above floor(log2(size)) is big enough, so
+        // only the exact class needs scanning and only as a last resort
+        for (uint32_t c = sizeClass(size) + 1; c < HEAP_NUM_CLASSES && block == NULL; c++)
+        {
+            if (!_classes[c].empty())
+            {
+                block = find(*_classes[c].begin());
+            }
+        }
+        std::set<uint32_t> &exact = _classes[sizeClass(size)];
+        for (std::set<uint32_t>::iterator it = exact.begin(); it != exact.end() && block == NULL; it++)
+        {
+            FreeBlock *candidate = find(*it);
+            if (candidate->size >= size)
+            {
+                block = candidate;
+            }
+        }
+    }
+
+    if (block == NULL)
+    {
+        return false;
+    }
+
+    *address = block->address;
+    carve(block, size);
+    _next_fit = *address + size;
+    return true;
+}
+
+void Heap::release(uint32_t address, uint32_t size)
+{
+    if (_policy == Buddy)
+    {
+        releaseBuddy(address, size);
+        return;
+    }
+
+    // Coalesce with free neighbours on either side
+    FreeBlock *before = predecessor(address);
+    if (before != NULL && before->address + before->size == address)
+    {
+        address = before->address;
+        size += before->size;
+        eraseBlock(address);
+        _merges++;
+    }
+    FreeBlock *after = successor(address);
+    if (after != NULL && address + size == after->address)
+    {
+        size += after->size;
+        eraseBlock(after->address);
+        _merges++;
+    }
+    insertBlock(address, size);
+}
+
+bool Heap::allocateBuddy(uint32_t size, uint32_t *address)
+{
+    uint32_t order = buddyOrder(size);
+    uint32_t top = 31 - __builtin_clz(_size);
+    uint32_t k = order;
+    while (k <= top && _buddy_free[k].empty())
+    {
+        k++;
+    }
+    if (k > top)
+    {
+        return false;
+    }
+
+    uint32_t block = *_buddy_free[k].begin();
+    _buddy_free[k].erase(_buddy_free[k].begin());
+
+    // Split down to the requested order, freeing the upper halves
+    while (k > order)
+    {
+        k--;
+        _buddy_free[k].insert(block + (1u << k));
+    }
+
+    *address = block;
+    _internal_waste += (1u << order) - size;
+    return true;
+}
+
+void Heap::releaseBuddy(uint32_t address, uint32_t size)
+{
+    uint32_t order = buddyOrder(size);
+    uint32_t top = 31 - __builtin_clz(_size);
+    _internal_waste -= (1u << order) - size;
+
+    while (order < top)
+    {
+        uint32_t buddy = address ^ (1u << order);
+        std::set<uint32_t>::iterator it = _buddy_free[order].find(buddy);
+        if (it == _buddy_free[order].end())
+        {
+            break;
+        }
+        _buddy_free[order].erase(it);
+        address &= ~(1u << order);
+        order++;
+        _merges++;
+    }
+    _buddy_free[order].insert(address);
+}
+
+void Heap::getStats(uint32_t top, HeapStats *stats)
+{
+    stats->free_blocks = 0;
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    stats->holes = 0;
+    stats->hole_bytes = 0;
+    stats->largest_hole = 0;
+    stats->internal_waste = _internal_waste;
+    stats->merges = _merges;
+
+    std::vector<std::pair<uint32_t, uint32_t> > blocks;
+    getBlocks(blocks);
+    for (int i = 0; i < blocks.size(); i++)
+    {
+        uint32_t size = blocks[i].second;
+        stats->free_blocks++;
+        stats->free_bytes += size;
+        if (size > stats->largest_free)
+        {
+            stats->largest_free = size;
+        }
+
+        // Space past the highest allocation has never been used, so only
+        // blocks below it count as holes
+        if (blocks[i].first < top)
+        {
+            uint32_t hole = std::min(size, top - blocks[i].first);
+            stats->holes++;
+            stats->hole_bytes += hole;
+            if (hole > stats->largest_hole)
+            {
+                stats->largest_hole = hole;
+            }
+        }
+    }
+}
+
+// Free space as (address, size) pairs; buddy blocks are always a power of
+// two, so their order follows from the size
+void Heap::getBlocks(std::vector<std::pair<uint32_t, uint32_t> > &blocks)
+{
+    if (_policy == Buddy)
+    {
+        for (int order = 0; order < HEAP_NUM_CLASSES; order++)
+        {
+            std::set<uint32_t>::iterator it;
+            for (it = _buddy_free[order].begin(); it != _buddy_free[order].end(); it++)
+            {
+                blocks.push_back(std::make_pair(*it, 1u << order));
+            }
+        }
+    }
+    else
+    {
+        std::vector<FreeBlock*> nodes;
+        collect(_root, nodes);
+        for (int i = 0; i < nodes.size(); i++)
+        {
+            blocks.push_back(std::make_pair(nodes[i]->address, nodes[i]->size));
+        }
+    }
+}
+
+// Replaces the free space of a freshly constructed heap
+void Heap::setBlocks(std::vector<std::pair<uint32_t, uint32_t> > &blocks)
+{
+    if (_policy == Buddy)
+    {
+        _buddy_free[31 - __builtin_clz(_size)].clear();
+    }
+    else
+    {
+        eraseBlock(0);
+    }
+    for (int i = 0; i < blocks.size(); i++)
+    {
+        if (_policy == Buddy) {
+            _buddy_free[sizeClass(blocks[i].second)].insert(blocks[i].first);
+        } else {
+            insertBlock(blocks[i].first, blocks[i].second);
+        }
+    }
+}
+
+Heap* Heap::clone()
+{
+    std::vector<std::pair<uint32_t, uint32_t> > blocks;
+    getBlocks(blocks);
+    Heap *heap = new Heap(_size, _policy);
+    heap->setBlocks(blocks);
+    heap->_rand_state = _rand_state;
+    heap->_next_fit = _next_fit;
+    heap->_internal_waste = _internal_waste;
+    heap->_merges = _merges;
+    return heap;
+}
+
+void Heap::save(SnapshotWriter &writer)
+{
+    std::vector<std::pair<uint32_t, uint32_t> > blocks;
+    getBlocks(blocks);
+
+    writer.put8(_policy);
+    writer.put32(_size);
+    writer.put32(_rand_state);
+    writer.put32(_next_fit);
+    writer.put64(_internal_waste);
+    writer.put64(_merges);
+    writer.put32(blocks.size());
+    for (int i = 0; i < blocks.size(); i++)
+    {
+        writer.put32(blocks[i].first);
+        writer.put32(blocks[i].second);
+    }
+}
+
+Heap* Heap::load(SnapshotReader &reader)
+{
+    uint8_t policy;
+    uint32_t size, rand_state, next_fit, num_blocks;
+    uint64_t internal_waste, merges;
+    if (!reader.get8(&policy) || policy > Segregated || !reader.get32(&size) || size == 0 || !reader.get32(&rand_state)
+     || !reader.get32(&next_fit) || !reader.get64(&internal_waste) || !reader.get64(&merges) || !reader.get32(&num_blocks))
+    {
+        return NULL;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t> > blocks;
+    for (uint32_t i = 0; i < num_blocks; i++)
+    {
+        uint32_t address, block_size;
+        if (!reader.get32(&address) || !reader.get32(&block_size) || block_size == 0)
+        {
+            return NULL;
+        }
+        blocks.push_back(std::make_pair(address, block_size));
+    }
+
+    // Start from an empty heap of the same shape, then put the free space back
+    Heap *heap = new Heap(size, (HeapPolicy)policy);
+    heap->setBlocks(blocks);
+    heap->_rand_state = rand_state;
+    heap->_next_fit = next_fit;
+    heap->_internal_waste = internal_waste;
+    heap->_merges = merges;
+    return heap;
+}
@@ -2,19 +2,31 @@
 #include <string>
 #include <cstring>
 #include <math.h>
+#include <chrono>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "mmu.h"
 #include "pagetable.h"
+#include "tlb.h"
+#include "cache.h"
+#include "analyzer.h"
+#include "sweep.h"
+#include "swapfile.h"
+#include "replacement.h"
+#include "placement.h"
+#include "simulator.h"
+#include "command.h"
+#include "parallelreplay.h"
+#include "binarytrace.h"
+#include "accesstrace.h"
+#include "stats.h"
 
 void printStartMessage(int page_size);
-void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table, int page_size);
-void allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table, int page_size);
-void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory);
-void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, int page_size);
-void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table, int page_size);
-int getTypeByteSize(DataType type);
-void checkAndFreePage(uint32_t pid, Mmu *mmu, PageTable *page_table, int page_size);
-
-int mem_utilization = 0;
+void* mapMemoryFile(std::string path, uint64_t size);
+bool parseSize(const char *text, uint64_t *size);
 
 int main(int argc, char **argv)
 {
@@ -25,204 +37,548 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // Print opening instuction message
+    // Parse optional simulator settings following the page size
     int page_size = std::stoi(argv[1]);
-    printStartMessage(page_size);
-
-    // Create physical 'memory'
-    uint32_t mem_size = 67108864;
-    void *memory = malloc(mem_size); // 64 MB (64 * 1024 * 1024)
-
-    // Create MMU and Page Table
-    Mmu *mmu = new Mmu(mem_size);
-    PageTable *page_table = new PageTable(page_size);
-
-    // Prompt loop
-    std::string command;
-    std::cout << "> ";
-    std::getline (std::cin, command);
-    while (command != "exit") {
-        // Handle command
-        //std::cout << command << '\n';
-        std::string hold = "";
-
-        std::vector<std::string> cmdcontainer;
-        for(int i = 0; i < command.length(); i++){
-            if(command[i] !=  ' '){
-                hold += command[i];
-                //std::cout << "hold is: " << hold << '\n';
-			} else {
-                cmdcontainer.push_back(hold);
-                hold.clear();
-			}
-		}
-
-        cmdcontainer.push_back(hold);
-        hold.clear();
-
-        for(int i = 0; i < cmdcontainer.size(); i++){
-            //std::cout << "cmd chunk " << i << " = " << cmdcontainer[i] << '\n';
+    int tlb_entries = 0;
+    int tlb_ways = 0;
+    TlbPolicy tlb_policy = TlbLru;
+    CacheHierarchy caches;
+    uint64_t analyze_window = 0;
+    std::vector<uint32_t> sweep_sizes;
+    uint32_t num_frames = 0;
+    uint32_t large_page_size = 0;
+    uint64_t mem_size = 67108864; // 64 MB (64 * 1024 * 1024)
+    uint64_t virtual_size = 67108864;
+    int num_threads = 0;
+    bool stats_on_exit = false;
+    std::string placement_name = "";
+    uint32_t placement_count = 0;
+    std::string swap_path = "";
+    std::string replacement_name = "";
+    std::string reference_file = "";
+    std::string record_refs_path = "";
+    std::string trace_path = "";
+    std::string record_path = "";
+    std::string replay_path = "";
+    std::string access_trace_path = "";
+    std::string generate_spec = "";
+    std::string generate_path = "";
+    std::string memory_path = "";
+    HeapPolicy heap_policy = FirstFit;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--tlb" && i + 3 < argc)
+        {
+            // --tlb <entries> <ways> <lru|fifo|random>, with 0 ways for fully associative
+            tlb_entries = std::stoi(argv[i + 1]);
+            tlb_ways = std::stoi(argv[i + 2]);
+            if (tlb_entries <= 0 || tlb_ways < 0 || (tlb_ways > 0 && tlb_entries % tlb_ways != 0)
+             || !Tlb::parsePolicy(argv[i + 3], &tlb_policy))
+            {
+                fprintf(stderr, "Error: invalid TLB configuration (entries must be a whole number of sets of <ways>)\n");
+                return 1;
+            }
+            i += 3;
+        }
+        else if (option == "--cache" && i + 4 < argc)
+        {
+            // --cache <size>[K|M|G] <line_size> <ways> <writeback|writethrough>, once per level from L1 outward
+            uint64_t cache_size;
+            bool write_back;
+            if (!parseSize(argv[i + 1], &cache_size) || !CacheHierarchy::parseWritePolicy(argv[i + 4], &write_back)
+             || !caches.addLevel(cache_size, std::stoul(argv[i + 2]), std::stoul(argv[i + 3]), write_back))
+            {
+                fprintf(stderr, "Error: invalid cache configuration (at most %d levels)\n", CACHE_MAX_LEVELS);
+                return 1;
+            }
+            i += 4;
+        }
+        else if (option == "--analyze" && i + 1 < argc)
+        {
+            // --analyze <window> tracks reuse distances and the working set over each process's last window page accesses
+            if (!parseSize(argv[i + 1], &analyze_window) || analyze_window == 0)
+            {
+                fprintf(stderr, "Error: invalid working-set window\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--sweep" && i + 1 < argc)
+        {
+            // --sweep <page_size>,<page_size>,... models LRU memories of every size at each page size in one pass
+            if (!PageSweep::parseSizes(argv[i + 1], &sweep_sizes))
+            {
+                fprintf(stderr, "Error: invalid sweep (page sizes must be powers of two up to 1G)\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--heap" && i + 1 < argc)
+        {
+            // --heap <first|best|next|buddy|segregated>
+            if (!Heap::parsePolicy(argv[i + 1], &heap_policy))
+            {
+                fprintf(stderr, "Error: invalid heap policy\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--frames" && i + 1 < argc)
+        {
+            // --frames <n> limits physical memory to n frames
+            num_frames = std::stoul(argv[i + 1]);
+            i += 1;
         }
+        else if (option == "--large-pages" && i + 1 < argc)
+        {
+            // --large-pages <bytes> backs aligned runs of pages inside large variables with one large page
+            large_page_size = std::stoul(argv[i + 1]);
+            uint32_t factor = large_page_size / page_size;
+            if (large_page_size % page_size != 0 || factor < 2 || (factor & (factor - 1)) != 0)
+            {
+                fprintf(stderr, "Error: large page size must be a power-of-two multiple of the page size\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--placement" && i + 2 < argc)
+        {
+            // --placement <color|first-touch|interleave|bind> <colors or nodes>
+            placement_name = argv[i + 1];
+            placement_count = std::stoul(argv[i + 2]);
+            i += 2;
+        }
+        else if (option == "--swap" && i + 2 < argc)
+        {
+            // --swap <swap_file> <fifo|lru|clock|optimal>
+            swap_path = argv[i + 1];
+            replacement_name = argv[i + 2];
+            i += 2;
+        }
+        else if (option == "--memory" && i + 1 < argc)
+        {
+            // --memory <bytes>[K|M|G] sets the size of physical memory
+            if (!parseSize(argv[i + 1], &mem_size) || mem_size < (uint64_t)page_size || mem_size / page_size > INT32_MAX)
+            {
+                fprintf(stderr, "Error: invalid memory size\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--virtual" && i + 1 < argc)
+        {
+            // --virtual <bytes>[K|M|G] sets the virtual address space of each process
+            if (!parseSize(argv[i + 1], &virtual_size) || virtual_size == 0 || virtual_size > UINT32_MAX)
+            {
+                fprintf(stderr, "Error: invalid virtual address space size (at most 4G - 1)\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--memory-file" && i + 1 < argc)
+        {
+            // --memory-file <file> keeps physical memory in a shared mapping of the file
+            memory_path = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--trace" && i + 1 < argc)
+        {
+            // --trace <file> replays commands from a file without prompting
+            trace_path = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--stats")
+        {
+            // --stats dumps operation statistics to stderr on exit
+            stats_on_exit = true;
+        }
+        else if (option == "--record" && i + 1 < argc)
+        {
+            // --record <file> captures every command run in the binary trace format
+            record_path = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--replay" && i + 1 < argc)
+        {
+            // --replay <file> runs a binary trace written by --record
+            replay_path = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--access-trace" && i + 1 < argc)
+        {
+            // --access-trace <file|-> replays raw "<pid> <R|W> <address> <size>" records
+            access_trace_path = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--generate" && i + 1 < argc)
+        {
+            // --generate <key=value,...> runs a synthetic workload instead of a trace
+            generate_spec = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--generate-out" && i + 1 < argc)
+        {
+            // --generate-out <file> writes the generated commands instead of running them
+            generate_path = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--threads" && i + 1 < argc)
+        {
+            // --threads <n> replays the trace on n worker threads, one MMU shard each
+            num_threads = std::stoi(argv[i + 1]);
+            if (num_threads <= 0)
+            {
+                fprintf(stderr, "Error: invalid thread count\n");
+                return 1;
+            }
+            i += 1;
+        }
+        else if (option == "--opt-refs" && i + 1 < argc)
+        {
+            // --opt-refs <file> supplies the future reference string for optimal
+            reference_file = argv[i + 1];
+            i += 1;
+        }
+        else if (option == "--record-refs" && i + 1 < argc)
+        {
+            // --record-refs <file> writes the reference string --opt-refs reads
+            record_refs_path = argv[i + 1];
+            i += 1;
+        }
+        else
+        {
+            fprintf(stderr, "Error: unrecognized option %s\n", argv[i]);
+            return 1;
+        }
+    }
 
-        if(cmdcontainer[0] == "create"){
-            //Initialize new process, print PID
-            createProcess(stoi(cmdcontainer[1]), stoi(cmdcontainer[2]), mmu, page_table, page_size);
-		}
+    WorkloadConfig workload;
+    WorkloadGenerator::defaultConfig(&workload);
+    if (generate_spec != "" && !WorkloadGenerator::parseSpec(generate_spec, &workload))
+    {
+        fprintf(stderr, "Error: invalid workload specification\n");
+        return 1;
+    }
+    if (generate_path != "")
+    {
+        std::ofstream out(generate_path.c_str());
+        if (!out)
+        {
+            fprintf(stderr, "Error: could not write %s\n", generate_path.c_str());
+            return 1;
+        }
+        WorkloadGenerator generator(workload);
+        std::string line;
+        while (generator.next(line))
+        {
+            out << line << '\n';
+        }
+        return 0;
+    }
 
-        //FreeSpace, Char, Short, Int, Float, Long, Double
+    if (num_threads > 0 && (trace_path == "" || swap_path != "" || record_path != "" || record_refs_path != ""))
+    {
+        fprintf(stderr, "Error: --threads needs --trace and cannot be combined with --swap, --record or --record-refs\n");
+        return 1;
+    }
 
-        else if(cmdcontainer[0] == "allocate"){
-            DataType type;
+    // Create physical 'memory'
+    // Physical memory is reserved as address space only; the kernel commits
+    // a page the first time a frame in it is touched
+    memory_size = mem_size;
+    void *memory;
+    if (memory_path != "") {
+        memory = mapMemoryFile(memory_path, mem_size);
+    } else {
+        memory = mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        memory = (memory == MAP_FAILED) ? NULL : memory;
+    }
+    if (memory == NULL)
+    {
+        fprintf(stderr, "Error: could not map %s as physical memory\n", (memory_path != "") ? memory_path.c_str() : "anonymous memory");
+        return 1;
+    }
 
-            if(cmdcontainer[3] == "freespace"){
-                type = FreeSpace;
-			} else if(cmdcontainer[3] == "char") {
-                type = Char;
-			} else if(cmdcontainer[3] == "short") {
-                type = Short;
-            } else if(cmdcontainer[3] == "int") {
-                type = Int;
-            } else if(cmdcontainer[3] == "float") {
-                type = Float;
-            } else if(cmdcontainer[3] == "long") {
-                type = Long;
-            } else if(cmdcontainer[3] == "double") {
-                type = Double;
-            } else {
-                std::cout << "error: illegal type" << '\n';     
-			}
+    // Only the first num_frames frames are handed out when physical memory is limited
+    uint64_t frame_memory = mem_size;
+    if (num_frames > 0 && (uint64_t)num_frames * page_size < mem_size)
+    {
+        frame_memory = (uint64_t)num_frames * page_size;
+    }
 
-            allocateVariable(stoi(cmdcontainer[1]), cmdcontainer[2], type, stoi(cmdcontainer[4]), mmu, page_table, page_size);
-		}
+    // Checked here so the frame count is known; every page table gets its own
+    // policy, for counters of its own
+    FramePlacement *placement = NULL;
+    if (placement_name != "")
+    {
+        placement = FramePlacement::create(placement_name, placement_count, frame_memory / page_size);
+        if (placement == NULL)
+        {
+            fprintf(stderr, "Error: invalid placement policy (page coloring needs a power-of-two number of colors)\n");
+            return 1;
+        }
+    }
 
-        //"  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)"
-        //void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory);
-        else if(cmdcontainer[0] == "set"){
-            Variable *inq = mmu->getVariableAt(stoi(cmdcontainer[1]), cmdcontainer[2]); //get var to check variable type.
-            if(inq == NULL){
-                std::cout << "error: variable not found\n"; //getVariableAt returns null if it threw an error. 
-			} else {
-                DataType type = inq->type;
-                int offset = stoi(cmdcontainer[3]);
-                int offsetInc = 0;
-                //std::cout << cmdcontainer.size() << std::endl;
-                for (int i = 4; i < cmdcontainer.size(); i++) {
-                    if(type == Char){
-                        char input = cmdcontainer[i][0];
-                        setVariable(stoi(cmdcontainer[1]), cmdcontainer[2], (uint32_t)(offset + offsetInc), &input, mmu, page_table, memory);
-                    }
-                    else if(type == Short){
-                        short input = stoi(cmdcontainer[i]);
-                        setVariable(stoi(cmdcontainer[1]), cmdcontainer[2], (uint32_t)(offset + offsetInc), &input, mmu, page_table, memory);
-                    }
-                    else if(type == Int){
-                        int input = stoi(cmdcontainer[i]);
-                        setVariable(stoi(cmdcontainer[1]), cmdcontainer[2], (uint32_t)(offset + offsetInc), &input, mmu, page_table, memory);
-                    }
-                    else if(type == Float){
-                        float input = stof(cmdcontainer[i]);
-                        setVariable(stoi(cmdcontainer[1]), cmdcontainer[2], (uint32_t)(offset + offsetInc), &input, mmu, page_table, memory);
-                    }
-                    else if(type == Long){
-                        long input = stol(cmdcontainer[i]);
-                        setVariable(stoi(cmdcontainer[1]), cmdcontainer[2], (uint32_t)(offset + offsetInc), &input, mmu, page_table, memory);
-                    }
-                    else if(type == Double){
-                        double input = stod(cmdcontainer[i]);
-                        setVariable(stoi(cmdcontainer[1]), cmdcontainer[2], (uint32_t)(offset + offsetInc), &input, mmu, page_table, memory);
-                    }
-                    offsetInc++;
-                }
+    if (num_threads > 0)
+    {
+        // One MMU, page table and TLB per worker; shards share physical frames
+        FrameAllocator *frames = new FrameAllocator(frame_memory / page_size);
+        std::vector<Simulator*> shards;
+        for (int i = 0; i < num_threads; i++)
+        {
+            Mmu *shard_mmu = new Mmu(virtual_size);
+            shard_mmu->setHeapPolicy(heap_policy);
+            shard_mmu->setSharded();
+            PageTable *shard_table = new PageTable(page_size, frames);
+            if (large_page_size > 0)
+            {
+                shard_table->enableLargePages(large_page_size);
             }
-           
-		}
-        else if(cmdcontainer[0] == "print"){
-            if(cmdcontainer[1] == "mmu"){
-                mmu->print();
-			} else if (cmdcontainer[1] == "page"){
-                page_table->print();    
-			} else if (cmdcontainer[1] == "processes"){
-                mmu->printProcesses();
-			} else {
-                    //split argument by colon     
-                    size_t found = cmdcontainer[1].find(":");
-                    if(found == std::string::npos){
-                        std::cout << "error: illegal print argument\n";
-                    } else {
-                        int pid = stoi(cmdcontainer[1].substr(0, found));
-                        std::string varname = cmdcontainer[1].substr(found + 1, cmdcontainer[1].length() - found + 1);
-                        //print the value of the variable indicated by the request
-                        Variable *inq = mmu->getVariableAt(pid, varname);
-                        int offset_inc = getTypeByteSize(inq->type);
-                        std::cout << varname << '\n';
-
-                        int numvars = inq->size / offset_inc; //how many values are in this variable?
-
-                        for(int i = 0; i < numvars; i++){
-                            int phys_addr = page_table->getPhysicalAddress(pid, inq->virtual_address + i);; //i acts as virtual offset for subvars
+            Tlb *shard_tlb = (tlb_entries > 0) ? new Tlb(tlb_entries, tlb_ways, tlb_policy) : NULL;
+            shard_table->setTlb(shard_tlb);
+            shard_table->setCache((caches.numLevels() > 0) ? new CacheHierarchy(caches) : NULL);
+            shard_table->setAnalyzer((analyze_window > 0) ? new WorkingSetAnalyzer(page_size, analyze_window) : NULL);
+            shard_table->setSweep((sweep_sizes.size() > 0) ? new PageSweep(sweep_sizes) : NULL);
+            shard_table->setPlacement((placement != NULL) ? FramePlacement::create(placement_name, placement_count, frame_memory / page_size) : NULL);
+            Simulator shard = {shard_mmu, shard_table, memory, page_size, shard_tlb, NULL, NULL};
+            shards.push_back(new Simulator(shard));
+        }
 
-                            if(inq->type == Char) {
-                                std::cout << ((char*)memory)[phys_addr];
-                            } else if(inq->type == Short) {
-                                std::cout << ((short*)memory)[phys_addr];
-                            } else if(inq->type == Int) {
-                                std::cout << ((int*)memory)[phys_addr];
-                            } else if(inq->type == Float) {
-                                std::cout << ((float*)memory)[phys_addr];
-                            } else if(inq->type == Long) {
-                                std::cout << ((long*)memory)[phys_addr];
-                            } else if(inq->type == Double) {
-                                std::cout << ((double*)memory)[phys_addr];
-                            }
+        std::ios::sync_with_stdio(false);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        long commands_run = runTraceParallel(trace_path, shards);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout.flush();
+        if (commands_run >= 0)
+        {
+            fprintf(stderr, "Replayed %ld commands on %d threads in %.3f s (%.0f commands/s)\n",
+                    commands_run, num_threads, elapsed.count(), commands_run / elapsed.count());
+        }
+        if (stats_on_exit)
+        {
+            // Every worker's histograms merge into one table; the counters stay per shard
+            printLatencyStats(std::cerr);
+            for (int i = 0; i < shards.size(); i++)
+            {
+                std::cerr << "[shard " << i << "]" << '\n';
+                printMachineStats(std::cerr, shards[i]->mmu, shards[i]->page_table);
+            }
+        }
 
-                            if(i < 3 || i < numvars - 1){
-                                std::cout << ", ";
-                            }
+        for (int i = 0; i < shards.size(); i++)
+        {
+            delete shards[i]->mmu;
+            delete shards[i]->page_table->cache();
+            delete shards[i]->page_table->analyzer();
+            delete shards[i]->page_table->sweep();
+            delete shards[i]->page_table->placement();
+            delete shards[i]->page_table;
+            delete shards[i]->tlb;
+            delete shards[i];
+        }
+        delete frames;
+        delete placement;
+        munmap(memory, mem_size);
+        return (commands_run < 0) ? 1 : 0;
+    }
 
-                            if(i == 4){
-                                break;
-                            }
-                        } 
+    // Create MMU and Page Table
+    Mmu *mmu = new Mmu(virtual_size);
+    mmu->setHeapPolicy(heap_policy);
+    PageTable *page_table = new PageTable(page_size, frame_memory);
+    if (large_page_size > 0)
+    {
+        page_table->enableLargePages(large_page_size);
+    }
+    Tlb *tlb = (tlb_entries > 0) ? new Tlb(tlb_entries, tlb_ways, tlb_policy) : NULL;
+    page_table->setTlb(tlb);
+    page_table->setCache((caches.numLevels() > 0) ? &caches : NULL);
+    WorkingSetAnalyzer *analyzer = (analyze_window > 0) ? new WorkingSetAnalyzer(page_size, analyze_window) : NULL;
+    page_table->setAnalyzer(analyzer);
+    PageSweep *sweep = (sweep_sizes.size() > 0) ? new PageSweep(sweep_sizes) : NULL;
+    page_table->setSweep(sweep);
+    page_table->setPlacement(placement);
+
+    // Set up demand paging
+    SwapFile *swap = NULL;
+    ReplacementPolicy *replacement = NULL;
+    if (swap_path != "")
+    {
+        swap = new SwapFile(swap_path, page_size);
+        replacement = ReplacementPolicy::create(replacement_name, frame_memory / page_size, reference_file);
+        if (!swap->isOpen() || replacement == NULL)
+        {
+            fprintf(stderr, "Error: invalid swap configuration (optimal also needs --opt-refs <file>)\n");
+            return 1;
+        }
+        page_table->enableSwap(memory, swap, replacement);
+        swap_enabled = true;
+    }
 
-                        if(numvars > 4){
-                            std::cout  << "...[" << numvars << " items]" << '\n';      
-                        } else {
-                            std::cout << '\n';        
-                        }
-                }
-			}
-		}
+    TraceRecorder *recorder = NULL;
+    if (record_path != "")
+    {
+        recorder = new TraceRecorder(record_path);
+        if (!recorder->isOpen())
+        {
+            fprintf(stderr, "Error: could not write %s\n", record_path.c_str());
+            return 1;
+        }
+    }
 
-        else if(cmdcontainer[0] == "free"){
-            freeVariable(stoi(cmdcontainer[1]), cmdcontainer[2], mmu, page_table, page_size);
-		}
+    std::ofstream *reference_log = NULL;
+    if (record_refs_path != "")
+    {
+        reference_log = new std::ofstream(record_refs_path.c_str());
+        if (!*reference_log)
+        {
+            fprintf(stderr, "Error: could not write %s\n", record_refs_path.c_str());
+            return 1;
+        }
+        page_table->setReferenceLog(reference_log);
+    }
 
-        else if(cmdcontainer[0] == "terminate"){
-            terminateProcess(stoi(cmdcontainer[1]), mmu, page_table, page_size);
-		}
+    Simulator sim = {mmu, page_table, memory, page_size, tlb, swap, recorder};
 
-        else if(cmdcontainer[0] == "exit"){
-            break;  
-		}
+    if (trace_path != "")
+    {
+        // Batch mode: no banner, no prompts and no per-line flushing
+        std::ios::sync_with_stdio(false);
+        if (runTrace(trace_path, &sim) < 0)
+        {
+            return 1;
+        }
+        std::cout.flush();
+    }
+    else if (replay_path != "")
+    {
+        // Binary traces skip the text parser entirely
+        std::ios::sync_with_stdio(false);
+        if (runBinaryTrace(replay_path, &sim) < 0)
+        {
+            return 1;
+        }
+        std::cout.flush();
+    }
+    else if (access_trace_path != "")
+    {
+        std::ios::sync_with_stdio(false);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        long records_run = runAccessTrace(access_trace_path, &sim);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout.flush();
+        if (records_run < 0)
+        {
+            return 1;
+        }
+        fprintf(stderr, "Ran %ld accesses in %.3f s (%.0f accesses/s)\n", records_run, elapsed.count(), records_run / elapsed.count());
+    }
+    else if (generate_spec != "")
+    {
+        // Generated commands run in batch mode as well
+        std::ios::sync_with_stdio(false);
+        WorkloadGenerator generator(workload);
+        runWorkload(&generator, &sim);
+        std::cout.flush();
+    }
+    else
+    {
+        // Print opening instuction message
+        printStartMessage(page_size);
+
+        // Prompt loop
+        std::string command;
+        std::vector<Token> args;
+        bool running = true;
+        while (running)
+        {
+            std::cout << "> ";
+            if (!std::getline(std::cin, command))
+            {
+                break;
+            }
 
-        else {
-            std::cout << "command recieved was: " << cmdcontainer[0] << '\n';
-            std::cout << "error: command not recognized" << '\n';  
-		}
+            tokenize(command.data(), command.data() + command.size(), args);
+            if (args.size() == 0)
+            {
+                std::cout << "error: command not recognized" << '\n';
+                continue;
+            }
+            running = executeCommand(args, &sim);
+        }
+    }
 
-        // Get next command
-        std::cout << "> ";
-        std::getline (std::cin, command);
+    if (stats_on_exit)
+    {
+        printStats(std::cerr, mmu, page_table);
     }
 
     // Clean up
-    free(memory);
+    munmap(memory, mem_size);
     delete mmu;
     delete page_table;
+    delete tlb;
+    delete analyzer;
+    delete sweep;
+    delete swap;
+    delete replacement;
+    delete placement;
+    delete recorder;
+    delete reference_log;
 
     return 0;
 }
 
+// Maps `path` as physical memory, growing the file to `size` bytes. Frame
+// contents outlive the process, and the kernel writes them back lazily.
+void* mapMemoryFile(std::string path, uint64_t size)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || ((uint64_t)info.st_size < size && ftruncate(fd, size) == -1))
+    {
+        close(fd);
+        return NULL;
+    }
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (memory == MAP_FAILED) ? NULL : memory;
+}
+
+// Parses a byte count with an optional K, M or G suffix (powers of 1024)
+bool parseSize(const char *text, uint64_t *size)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text)
+    {
+        return false;
+    }
+    int shift = 0;
+    if (*end == 'K' || *end == 'k') {
+        shift = 10;
+    } else if (*end == 'M' || *end == 'm') {
+        shift = 20;
+    } else if (*end == 'G' || *end == 'g') {
+        shift = 30;
+    }
+    if (shift > 0)
+    {
+        end++;
+    }
+    if (*end != '\0' || value > (UINT64_MAX >> shift))
+    {
+        return false;
+    }
+    *size = (uint64_t)value << shift;
+    return true;
+}
+
 void printStartMessage(int page_size)
 {
     std::cout << "Welcome to the Memory Allocation Simulator! Using a page size of " << page_size << " bytes." << std:: endl;
@@ -232,213 +588,24 @@ void printStartMessage(int page_size)
     std::cout << "  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)" << std:: endl;
     std::cout << "  * free <PID> <var_name> (deallocate memory on the heap that is associated with <var_name>)" << std:: endl;
     std::cout << "  * terminate <PID> (kill the specified process)" << std:: endl;
+    std::cout << "  * fork <PID> (copy a process, sharing its pages until either side writes them)" << std:: endl;
+    std::cout << "  * snapshot <file> (save processes, page tables and memory contents to a file)" << std:: endl;
+    std::cout << "  * restore <file> (replace the current state with a saved snapshot)" << std:: endl;
     std::cout << "  * print <object> (prints data)" << std:: endl;
     std::cout << "    * If <object> is \"mmu\", print the MMU memory table" << std:: endl;
     std::cout << "    * if <object> is \"page\", print the page table" << std:: endl;
     std::cout << "    * if <object> is \"processes\", print a list of PIDs for processes that are still running" << std:: endl;
+    std::cout << "    * if <object> is \"heap\", print free space and fragmentation for each process" << std:: endl;
+    std::cout << "    * if <object> is \"tlb\", print TLB hit/miss statistics" << std:: endl;
+    std::cout << "    * if <object> is \"cache\", print cache hit rates per level and per process" << std:: endl;
+    std::cout << "    * if <object> is \"workingset\", print working sets, reuse distances and the footprint at each page size" << std:: endl;
+    std::cout << "    * if <object> is \"sweep\", print LRU fault rates by memory size for every swept page size" << std:: endl;
+    std::cout << "    * if <object> is \"placement\", print frames in use per color or NUMA node and local/remote accesses" << std:: endl;
+    std::cout << "    * if <object> is \"swap\", print page fault, eviction and swap statistics" << std:: endl;
+    std::cout << "    * if <object> is \"largepages\", print large pages in use and the page table entries and TLB reach they save" << std:: endl;
+    std::cout << "    * if <object> is \"stats\", print operation latencies, page faults and free-space fragments" << std:: endl;
+    std::cout << "    * if <object> is \"memory\", print the simulator's own record pools and resident set size" << std:: endl;
     std::cout << "    * if <object> is a \"<PID>:<var_name>\", print the value of the variable for that process" << std:: endl;
     std::cout << std::endl;
 }
 
-void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table, int page_size)
-{
-    // TODO: implement this!
-    //   - create new process in the MMU
-    uint32_t PID = mmu->createProcess();
-
-    //   - allocate new variables for the <TEXT>, <GLOBALS>, and <STACK>
-    allocateVariable(PID, "<TEXT>", DataType::Char, text_size, mmu, page_table, page_size);
-    allocateVariable(PID, "<GLOBALS>", DataType::Char, data_size, mmu, page_table, page_size);
-    allocateVariable(PID, "<STACK>", DataType::Char, 65536, mmu, page_table, page_size);
-
-    //   - print pid
-    std::cout << PID << '\n';
-}
-
-void allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table, int page_size)
-{
-    // TODO: implement this!
-    if(mmu->isProcessInMMU(pid) == 0){
-        std::cout << "error: process not found" << '\n';
-        return;
-	}
-
-    uint32_t req_size = getTypeByteSize(type) * num_elements;
-
-    mem_utilization += req_size;
-    if(mem_utilization > 67108864){
-        std::cout << "error: allocation exceeds memory size. \n";
-        return;
-    }
-
-    Process *p = mmu->getProcessAt(pid);
-    //   - find first free space within a page already allocated to this process that is large enough to fit the new variable
-    Variable *target;
-    for(int i = 0; i < p->variables.size(); i++){
-        if(p->variables[i]->type == FreeSpace && p->variables[i]->size > req_size){
-            target = p->variables[i]; 
-            break;
-		} //get first hole large enough for allocation
-	}
-
-    uint32_t prev_addr; //this is the address we will be allocating the variable to.
-
-     //  - if no hole is large enough, allocate new page(s)
-    if(target == NULL){
-        int pagenum = trunc((p->variables[p->variables.size() - 1]->virtual_address / page_size)+1); //get page number of last element in variables and then add 1.
-        prev_addr = pagenum * page_size;
-        mmu->addVariableToProcess(pid, "<FREE_SPACE>", FreeSpace, page_size, prev_addr); //BREAKPOINT - virtual address for new 'page' is the page # * pagesize.
-        page_table->addEntry(pid, pagenum);
-        target = p->variables[p->variables.size() - 1]; //new page starts at the latest index
-	} else if(target->size > page_size){ //this is unsized free-space.
-        int pagenum = trunc((p->variables[p->variables.size() - 1]->virtual_address / page_size)+1);
-        //std::cout << page_size - p->variables[p->variables.size() - 1]->size << '\n';
-
-        page_table->addEntry(pid, pagenum);
-        prev_addr = target->virtual_address;
-    } else { //   - insert variable into MMU
-        prev_addr = target->virtual_address;
-	}
-
-    target->virtual_address += req_size;
-    target->size -= req_size;
-    mmu->addVariableToProcess(pid, var_name, type, req_size, prev_addr);
-
-    //   - print virtual memory address
-    if(var_name != "<TEXT>" && var_name != "<GLOBALS>" && var_name != "<STACK>")
-        std::cout << prev_addr << '\n';
-
-}
-
-void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory)
-{ 
-    Process *p = mmu->getProcessAt(pid);
-    int physical_address;
-    DataType dt;
-
-    if (p == NULL) {
-        std::cout << "error: process not found" << std::endl;
-    } else { //   - look up physical address for variable based on its virtual address / offset
-        Variable *var = mmu->getVariableAt(pid, var_name);
-        dt = var->type;
-        physical_address = page_table->getPhysicalAddress(pid, var->virtual_address + (offset*getTypeByteSize(dt)));
-        if (var == NULL) {
-            std::cout << "error: variable not found" << std::endl;
-        }else {  //   - insert `value` into `memory` at physical address
-            if(dt == Char)
-            {
-                memcpy(((char*)memory) + physical_address, value, 1);
-            }
-            if(dt == Short)
-            {
-                memcpy(((short*)memory) + physical_address, value, 2);
-            }
-            if(dt == Int)
-            {
-                memcpy(((int*)memory) + physical_address, value, 4);
-            }
-            if(dt == Float)
-            {
-                memcpy(((float*)memory) + physical_address, value, 4);
-            }
-            if(dt == Double)
-            {
-                memcpy(((double*)memory) + physical_address, value, 8);
-            }
-            if(dt == Long)
-            {
-                memcpy(((long*)memory) + physical_address, value, 8);
-            }
-        }
-    }
-}
-
-void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, int page_size)
-{
-    // TODO: implement this!
-    if(mmu->isProcessInMMU(pid) == 0){
-        std::cout << "error: process not found" << '\n';
-        return;
-	}
-    
-    //   - remove entry from MMU
-    Variable *toRemove = mmu->getVariableAt(pid, var_name);
-    toRemove->name = "<FREE_SPACE>";
-    toRemove->type = FreeSpace;
-
-    //if newFree has free space neighbors, merge them.
-    mmu->checkAndMerge(pid, toRemove, page_size);
-
-    //   - free page if this variable was the only one on a given page
-    checkAndFreePage(pid, mmu, page_table, page_size); 
-}
-
-void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table, int page_size)
-{
-    if(mmu->isProcessInMMU(pid) == 0){
-        std::cout << "error: process not found" << '\n';
-        return;
-	}
-
-    Process *toKill = mmu->getProcessAt(pid);
-    for(int i = 0; i < toKill->variables.size(); i++){
-        freeVariable(pid, toKill->variables[i]->name, mmu, page_table, page_size); //when this finishes all pages will be freed as a consequence.
-	}
-
-    mmu->killProcess(pid);
-}
-
-int getTypeByteSize(DataType type){
-    if(type == FreeSpace){ //set offset incrementer based on datatype.
-            return 1;
-	} else if(type == Char) {
-            return 1;
-    } else if(type == Short) {
-            return 2;
-    } else if(type == Int) {
-            return 4;
-    } else if(type == Float) {
-            return 4;
-    } else if(type == Long) {
-            return 8;
-    } else if(type == Double) {
-            return 8;
-    } else {
-            std::cout << "error: incorrect type passed to getTypeByteSize" << '\n';
-            return -1;
-    }
-}
-
-void checkAndFreePage(uint32_t pid, Mmu *mmu, PageTable *page_table, int page_size){
-    int currPage = 0;
-    std::vector<bool> toBeFreed;
-    Process *toFree = mmu->getProcessAt(pid);
-
-    int counter = 0;
-    int flag = 0;
-    int i = 0;
-    while(i < toFree->variables.size()){
-        while(counter < page_size && i < toFree->variables.size()){
-            if(toFree->variables[i]->name != "<FREE_SPACE>"){
-               flag = 1;  
-		    }
-            counter += toFree->variables[i]->size;
-            i++;
-        }
-
-        if(flag == 0){ 
-            toBeFreed.push_back(true);
-		} else {
-            toBeFreed.push_back(false);  
-		}
-
-        flag = 0;
-        counter = 0;
-    }
-
-    for(int i = 0; i < toBeFreed.size(); i++){
-        if(toBeFreed[i]){
-            page_table->removePageEntry(pid, i);  //BREAKPOINT: For this to work, i MUST correspond to page_number. 
-		}
-	}
-}
\ No newline at end of file
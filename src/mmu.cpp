@@ -1,207 +1,475 @@
 #include <iomanip>
 #include <math.h>
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
 #include "mmu.h"
+#include "output.h"
+#include "stats.h"
+#include "snapshot.h"
 
-Mmu::Mmu(int memory_size)
+Mmu::Mmu(uint32_t virtual_size)
 {
-    _next_pid = 1024;
-    _max_size = memory_size;
+    _base_pid = PID_BASE;
+    _max_size = virtual_size;
+    _sharded = false;
+    _slot_assigned = false;
+    _heap_policy = FirstFit;
 }
 
 Mmu::~Mmu()
 {
+    for (int i = 0; i < _slots.size(); i++)
+    {
+        if (_slots[i].proc != NULL)
+        {
+            releaseProcess(_slots[i].proc);
+        }
+    }
 }
 
-uint32_t Mmu::createProcess()
+void Mmu::setHeapPolicy(HeapPolicy policy)
 {
-    Process *proc = new Process();
-    proc->pid = _next_pid;
+    _heap_policy = policy;
+}
 
-    Variable *var = new Variable();
-    var->name = "<FREE_SPACE>";
-    var->type = DataType::FreeSpace;
-    var->virtual_address = 0;
-    var->size = _max_size;
-    proc->variables.push_back(var);
+void Mmu::setSharded()
+{
+    _sharded = true;
+}
 
-    _processes.push_back(proc);
+bool Mmu::isSharded()
+{
+    return _sharded;
+}
 
-    _next_pid++;
-    return proc->pid;
+// Makes the next created or forked process take this slot and generation
+// rather than one from this MMU's own free list
+void Mmu::assignSlot(uint32_t slot, uint32_t generation)
+{
+    _slot_assigned = true;
+    _next_slot = slot;
+    _next_generation = generation;
 }
 
-void Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint32_t size, uint32_t address)
+// Takes a slot and a pid for a process that has no heap yet. Returns NULL if
+// the assigned slot still holds a process.
+Process* Mmu::newProcess()
 {
-    int i;
-    Process *proc = NULL;
-    for (i = 0; i < _processes.size(); i++)
+    // Reuse a vacated slot if there is one; its new generation gives a fresh pid
+    uint32_t slot;
+    if (_slot_assigned)
     {
-        if (_processes[i]->pid == pid)
+        slot = _next_slot;
+        _slot_assigned = false;
+        if (slot >= _slots.size())
         {
-            proc = _processes[i];
+            ProcessSlot empty = {NULL, 0};
+            _slots.resize(slot + 1, empty);
         }
+        if (_slots[slot].proc != NULL)
+        {
+            return NULL;
+        }
+        _slots[slot].generation = _next_generation;
+    }
+    else if (_free_slots.size() > 0)
+    {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+    }
+    else
+    {
+        slot = _slots.size();
+        ProcessSlot empty = {NULL, 0};
+        _slots.push_back(empty);
+    }
+
+    Process *proc = _process_pool.acquire();
+    proc->pid = _base_pid + ((_slots[slot].generation << PID_SLOT_BITS) | slot);
+    _slots[slot].proc = proc;
+    return proc;
+}
+
+// Returns 0 if no process could be created
+uint32_t Mmu::createProcess()
+{
+    Process *proc = newProcess();
+    if (proc == NULL)
+    {
+        return 0;
+    }
+    proc->heap = new Heap(_max_size, _heap_policy);
+    return proc->pid;
+}
+
+// Gives the child the same variables at the same addresses and a copy of the
+// parent's free space; the page table decides which frames the two share.
+// Returns 0 if no process could be created.
+uint32_t Mmu::forkProcess(uint32_t pid)
+{
+    Process *parent = getProcessAt(pid);
+    Process *child = newProcess();
+    if (child == NULL)
+    {
+        return 0;
+    }
+    child->heap = parent->heap->clone();
+
+    std::map<uint32_t, Variable*>::iterator it;
+    for (it = parent->variables.begin(); it != parent->variables.end(); it++)
+    {
+        Variable *var = _variable_pool.acquire();
+        *var = *it->second;
+        child->variables.insert(child->variables.end(), std::make_pair(var->virtual_address, var));
+        child->index[var->name] = var;
     }
+    return child->pid;
+}
 
-    Variable *var = new Variable();
+void Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint32_t size, uint32_t address)
+{
+    Process *proc = getProcessAt(pid);
+    if (proc == NULL)
+    {
+        return;
+    }
+
+    Variable *var = _variable_pool.acquire();
     var->name = var_name;
     var->type = type;
     var->virtual_address = address;
     var->size = size;
-    if (proc != NULL)
-    {
-        proc->variables.push_back(var);
-    }
+    proc->variables[address] = var;
+    proc->index[var_name] = var;
 }
 
 int Mmu::isProcessInMMU(uint32_t pid){
-    for(int i = 0; i < _processes.size(); i++){
-        if(_processes[i]->pid == pid){
-            return 1;  
-		}
-	}
-
-    return 0; //if no match is found
+    return getProcessAt(pid) != NULL;
 }
 
 Process* Mmu::getProcessAt(uint32_t pid){
-    for (int i = 0; i < _processes.size(); i++)
+    ProcessSlot *slot = lookupSlot(pid);
+    return (slot != NULL) ? slot->proc : NULL;
+}
+
+ProcessSlot* Mmu::lookupSlot(uint32_t pid)
+{
+    if (pid < _base_pid)
     {
-        if (_processes[i]->pid == pid)
-        {
-            return _processes[i];
-        }
+        return NULL;
+    }
+
+    uint32_t slot = (pid - _base_pid) & PID_SLOT_MASK;
+    uint32_t generation = (pid - _base_pid) >> PID_SLOT_BITS;
+    if (slot >= _slots.size() || _slots[slot].generation != generation)
+    {
+        return NULL; // stale pid from an earlier occupant of the slot
     }
 
-    return NULL;
+    return &_slots[slot];
 }
 
-Variable* Mmu::getVariableAt(uint32_t pid, std::string desiredVar){
+Variable* Mmu::getVariableAt(uint32_t pid, const std::string &desiredVar){
     Process *p = getProcessAt(pid);
 
     if(p == NULL){
-        std::cout << "error: process does not exist";
+        simOut() << "error: process does not exist";
         return NULL; //self explanatory
 	}
 
-    //std::cout << "looking for " << desiredVar << '\n';
-
-    for(int i = 0; i < p->variables.size(); i++){
-        //std::cout << "Is " << p->variables[i]->name << "equal to" << desiredVar << " \n";
-        if(p->variables[i]->name == desiredVar){
-            return p->variables[i];
-	    }
-	}
-    return NULL;
+    std::unordered_map<std::string, Variable*>::iterator it = p->index.find(desiredVar);
+    if(it == p->index.end()){
+        return NULL;
+    }
+    return it->second;
 }
 
 void Mmu::print()
 {
-    int i, j;
+    int i;
 
     std::cout << " PID  | Variable Name | Virtual Addr | Size" << std::endl;
     std::cout << "------+---------------+--------------+------------" << std::endl;
-    for (i = 0; i < _processes.size(); i++)
+    for (i = 0; i < _slots.size(); i++)
     {
-        for (j = 0; j < _processes[i]->variables.size(); j++)
+        Process *proc = _slots[i].proc;
+        if (proc == NULL)
         {
-            if(_processes[i]->variables[j]->name != "<FREE_SPACE>"){ 
-                uint32_t pid = _processes[i]->pid;
-                std::string varname = _processes[i]->variables[j]->name;
-                uint32_t addr = _processes[i]->variables[j]->virtual_address;
-                uint32_t size = _processes[i]->variables[j]->size;
+            continue;
+        }
+        std::map<uint32_t, Variable*>::iterator it;
+        for (it = proc->variables.begin(); it != proc->variables.end(); it++)
+        {
+            uint32_t pid = proc->pid;
+            std::string varname = it->second->name;
+            uint32_t addr = it->second->virtual_address;
+            uint32_t size = it->second->size;
 
-                std::cout << std::setw(5) << pid << " | " << std::setw(13) << varname << " | " << std::setw(12) << addr << " | " << size << '\n';
-            }
+            std::cout << std::setw(5) << pid << " | " << std::setw(13) << varname << " | " << std::setw(12) << addr << " | " << size << '\n';
         }
     }
 }
 
 void Mmu:: killProcess(uint32_t pid){
-    for(int i = 0; i < _processes.size(); i++){
-        if(_processes[i]->pid == pid){
-            _processes.erase(_processes.begin() + i);  
-		}
+    ProcessSlot *slot = lookupSlot(pid);
+    if(slot == NULL || slot->proc == NULL){
+        return;
+    }
+    releaseProcess(slot->proc);
+
+    // Vacate the slot; bumping the generation invalidates the old pid
+    slot->proc = NULL;
+    slot->generation = (slot->generation + 1) & ((1u << (32 - PID_SLOT_BITS)) - 1);
+    if (!_sharded)
+    {
+        _free_slots.push_back(slot - &_slots[0]); // shards are assigned their slots
+    }
+}
+
+void Mmu::checkAndMerge(uint32_t pid, Variable *var){ //hand a freed variable's range back to the heap, which merges it with adjacent free space
+    STAT_TIMER(StatCheckAndMerge);
+    Process *inq = getProcessAt(pid);
+    if(inq == NULL){
+        return;
+    }
+
+    inq->index.erase(var->name);
+    inq->variables.erase(var->virtual_address);
+    inq->heap->release(var->virtual_address, var->size);
+    _variable_pool.release(var);
+}
+
+// Hands a process record, any variables it still owns and its heap back in one pass
+void Mmu::releaseProcess(Process *proc)
+{
+    std::map<uint32_t, Variable*>::iterator it;
+    for (it = proc->variables.begin(); it != proc->variables.end(); it++)
+    {
+        _variable_pool.release(it->second);
+    }
+    delete proc->heap;
+    _process_pool.release(proc);
+}
+
+void Mmu::printProcesses(){
+    for(int i = 0; i < _slots.size(); i++){
+        if(_slots[i].proc != NULL){
+            std::cout << _slots[i].proc->pid << '\n';        
+        }
 	}
 }
 
-void Mmu::checkAndMerge(uint32_t pid, Variable *var, uint32_t page_size){ //for a process, check for ANY adjacent FreeSpaces within the variable's page and merge.
-    int currPage = 0;
-    int byteCounter = 0;
-    
-    Process *inq;
-    for (int i = 0; i < _processes.size(); i++)
+void Mmu::processHeapStats(Process *proc, HeapStats *stats)
+{
+    // The top of the heap is the end of the highest allocated variable
+    uint32_t top = 0;
+    if (!proc->variables.empty())
+    {
+        Variable *last = proc->variables.rbegin()->second;
+        top = last->virtual_address + last->size;
+    }
+    proc->heap->getStats(top, stats);
+}
+
+void Mmu::getHeapTotals(HeapStats *total)
+{
+    HeapStats empty = {0, 0, 0, 0, 0, 0, 0, 0};
+    *total = empty;
+    for (int i = 0; i < _slots.size(); i++)
     {
-        if (_processes[i]->pid == pid)
+        if (_slots[i].proc == NULL)
         {
-            inq = _processes[i];
+            continue;
         }
+        HeapStats stats;
+        processHeapStats(_slots[i].proc, &stats);
+        total->free_blocks += stats.free_blocks;
+        total->free_bytes += stats.free_bytes;
+        total->largest_free = std::max(total->largest_free, stats.largest_free);
+        total->holes += stats.holes;
+        total->hole_bytes += stats.hole_bytes;
+        total->largest_hole = std::max(total->largest_hole, stats.largest_hole);
+        total->internal_waste += stats.internal_waste;
+        total->merges += stats.merges;
     }
+}
 
-    int toCheck = -1;
+void Mmu::printHeap()
+{
+    HeapStats total = {0, 0, 0, 0, 0, 0, 0, 0};
+    int i;
 
-    for(int i = 0; i < inq->variables.size(); i++){
-        if(inq->variables[i] == var){
-              toCheck = i;
-		}
-	}
+    std::cout << "Heap policy: " << Heap::policyName(_heap_policy) << '\n';
+    std::cout << " PID  | Free Blocks | Holes | Hole Bytes | Largest Hole | Ext. Frag | Merges" << '\n';
+    std::cout << "------+-------------+-------+------------+--------------+-----------+--------" << '\n';
+    for (i = 0; i < _slots.size(); i++)
+    {
+        Process *proc = _slots[i].proc;
+        if (proc == NULL)
+        {
+            continue;
+        }
+
+        HeapStats stats;
+        processHeapStats(proc, &stats);
+        double fragmentation = (stats.hole_bytes > 0) ? 100.0 * (1.0 - (double)stats.largest_hole / stats.hole_bytes) : 0.0;
+        std::cout << std::setw(5) << proc->pid << " | " << std::setw(11) << stats.free_blocks << " | " << std::setw(5) << stats.holes << " | "
+                  << std::setw(10) << stats.hole_bytes << " | " << std::setw(12) << stats.largest_hole << " | "
+                  << std::setw(8) << std::fixed << std::setprecision(2) << fragmentation << "%" << " | " << stats.merges << '\n';
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout.precision(6);
 
-    std::cout << "Found FreeSpace to check. \n";
-    
+        total.holes += stats.holes;
+        total.hole_bytes += stats.hole_bytes;
+        total.internal_waste += stats.internal_waste;
+        total.merges += stats.merges;
+    }
+    std::cout << "Total holes: " << total.holes << " (" << total.hole_bytes << " bytes), internal fragmentation: "
+              << total.internal_waste << " bytes, merges: " << total.merges << '\n';
+}
+void Mmu::printFootprint()
+{
+    uint64_t live_processes = _process_pool.live();
+    uint64_t live_variables = _variable_pool.live();
 
-    if(toCheck == -1){
-        std::cout << "error: variable not found. did you pass an incorrect argument to checkAndMerge?" << '\n';
-	} else {
-        int pgstart = trunc(inq->variables[toCheck]->virtual_address / page_size) * page_size; //start of page in VM is virtual addr / page size truncated and then remultiplied by pgsize
-        int pgend = pgstart + page_size; //end of this page is just page_size bytes away from pgstart
+    std::cout << "Record   | Live       | Capacity   | Reserved Bytes" << '\n';
+    std::cout << "---------+------------+------------+----------------" << '\n';
+    std::cout << "Process  | " << std::setw(10) << live_processes << " | " << std::setw(10) << _process_pool.capacity()
+              << " | " << _process_pool.bytesReserved() << '\n';
+    std::cout << "Variable | " << std::setw(10) << live_variables << " | " << std::setw(10) << _variable_pool.capacity()
+              << " | " << _variable_pool.bytesReserved() << '\n';
+    std::cout << "Process slots: " << _slots.size() << " (" << _free_slots.size() << " free)" << '\n';
+
+    // Resident set size of the simulator itself, so steady state can be confirmed over long replays
+    long pages_total, pages_resident;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL && fscanf(statm, "%ld %ld", &pages_total, &pages_resident) == 2)
+    {
+        long system_page = sysconf(_SC_PAGESIZE);
+        std::cout << "Simulator RSS: " << (uint64_t)pages_resident * system_page / 1024 << " KB, virtual size: "
+                  << (uint64_t)pages_total * system_page / 1024 << " KB" << '\n';
+    }
+    else
+    {
+        std::cout << "Simulator RSS: unavailable" << '\n';
+    }
+    if (statm != NULL)
+    {
+        fclose(statm);
+    }
+}
 
-        if(toCheck == 0 && inq->variables.size() > 1){
-            mergeHelper(1, inq, pgstart, pgend, toCheck);
-        } else if (toCheck > 0 && toCheck < inq->variables.size()-1){
-            mergeHelper(0, inq, pgstart, pgend, toCheck);
-        } else if(toCheck == inq->variables.size() - 1 && inq->variables.size() > 1){
-            mergeHelper(2, inq, pgstart, pgend, toCheck);
+// The slot table is saved whole, vacated slots and their order included, so
+// a restored MMU hands out the same PIDs the original would have
+void Mmu::save(SnapshotWriter &writer)
+{
+    writer.put32(_slots.size());
+    for (int i = 0; i < _slots.size(); i++)
+    {
+        Process *proc = _slots[i].proc;
+        writer.put32(_slots[i].generation);
+        writer.put8(proc != NULL);
+        if (proc == NULL)
+        {
+            continue;
         }
-	}
 
+        writer.put32(proc->pid);
+        writer.put32(proc->variables.size());
+        std::map<uint32_t, Variable*>::iterator it;
+        for (it = proc->variables.begin(); it != proc->variables.end(); it++)
+        {
+            writer.putString(it->second->name);
+            writer.put8(it->second->type);
+            writer.put32(it->second->virtual_address);
+            writer.put32(it->second->size);
+        }
+        proc->heap->save(writer);
+    }
+
+    writer.put32(_free_slots.size());
+    for (int i = 0; i < _free_slots.size(); i++)
+    {
+        writer.put32(_free_slots[i]);
+    }
 }
 
-void Mmu::mergeHelper(int lrc, Process *inq, int pgstart, int pgend, int toCheck){
-    if(lrc == 0){ //inq toCheck has two neighbors
-        if(toCheck < inq->variables.size() - 2 && inq->variables[toCheck - 1]->name == "<FREE_SPACE>" && inq->variables[toCheck + 1]->name == "<FREE_SPACE>"){ //Merge L&R
-            //Check page matches RIGHT to LEFT to avoid unusual FS distributions
-            if(inq->variables[toCheck + 1]->virtual_address + inq->variables[toCheck + 1]->size <= pgend){ //is the right freespace on the same page?
-                inq->variables[toCheck]->size += inq->variables[toCheck + 1]->size;
-                inq->variables.erase(inq->variables.begin() + (toCheck + 1));
+bool Mmu::load(SnapshotReader &reader, uint64_t *variable_bytes)
+{
+    for (int i = 0; i < _slots.size(); i++)
+    {
+        if (_slots[i].proc != NULL)
+        {
+            releaseProcess(_slots[i].proc);
+        }
+    }
+    _slots.clear();
+    _free_slots.clear();
+    *variable_bytes = 0;
+
+    uint32_t num_slots;
+    if (!reader.get32(&num_slots))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_slots; i++)
+    {
+        uint8_t occupied;
+        ProcessSlot slot = {NULL, 0};
+        if (!reader.get32(&slot.generation) || !reader.get8(&occupied))
+        {
+            return false;
+        }
+        _slots.push_back(slot);
+        if (!occupied)
+        {
+            continue;
+        }
+
+        uint32_t num_variables;
+        Process *proc = _process_pool.acquire();
+        proc->heap = NULL;
+        _slots.back().proc = proc;
+        if (!reader.get32(&proc->pid) || !reader.get32(&num_variables))
+        {
+            return false;
+        }
+        for (uint32_t v = 0; v < num_variables; v++)
+        {
+            Variable *var = _variable_pool.acquire();
+            uint8_t type;
+            bool valid = reader.getString(&var->name) && reader.get8(&type) && type <= Double
+                      && reader.get32(&var->virtual_address) && reader.get32(&var->size);
+            var->type = (DataType)type;
+            proc->variables[var->virtual_address] = var;
+            proc->index[var->name] = var;
+            if (!valid)
+            {
+                return false;
             }
-            
-            if(inq->variables[toCheck - 1]->virtual_address >= pgstart){ //is the left freespace on the same page?
-                inq->variables[toCheck - 1]->size += inq->variables[toCheck]->size;
-                inq->variables.erase(inq->variables.begin() + (toCheck));
-			}
-            
-		}
-        else if (inq->variables[toCheck - 1]->name == "<FREE_SPACE>" && inq->variables[toCheck + 1]->name != "<FREE_SPACE>" && inq->variables[toCheck - 1]->virtual_address >= pgstart){ //Merge L
-            inq->variables[toCheck - 1]->size += inq->variables[toCheck]->size;
-            inq->variables.erase(inq->variables.begin() + (toCheck));
-        } else if(inq->variables[toCheck - 1]->name != "<FREE_SPACE>" && inq->variables[toCheck + 1]->name == "<FREE_SPACE>" && inq->variables[toCheck + 1]->virtual_address + inq->variables[toCheck + 1]->size <= pgend){ //Merge R
-            inq->variables[toCheck]->size += inq->variables[toCheck + 1]->size;
-            inq->variables.erase(inq->variables.begin() + (toCheck + 1));
-		}
-    } else if (lrc == 1){ //toCheck has a right neighbor
-        if(inq->variables[toCheck + 1]->name == "<FREE_SPACE>" && inq->variables[toCheck + 1]->virtual_address + inq->variables[toCheck + 1]->size <= pgend){ //Merge R
-            inq->variables[toCheck]->size += inq->variables[toCheck + 1]->size;
-            inq->variables.erase(inq->variables.begin() + (toCheck + 1));
-		}
-    } else { //toCheck has a left neighbor
-        if(inq->variables[toCheck - 1]->name == "<FREE_SPACE>" && inq->variables[toCheck - 1]->virtual_address >= pgstart){ //Merge L
-            inq->variables[toCheck - 1]->size += inq->variables[toCheck]->size;
-            inq->variables.erase(inq->variables.begin() + (toCheck));
-		}
+            *variable_bytes += var->size;
+        }
+        proc->heap = Heap::load(reader);
+        if (proc->heap == NULL)
+        {
+            return false;
+        }
     }
-}
 
-void Mmu::printProcesses(){
-    for(int i = 0; i < _processes.size(); i++){
-        std::cout << _processes[i]->pid << '\n';        
-	}
-}
\ No newline at end of file
+    uint32_t num_free;
+    if (!reader.get32(&num_free))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_free; i++)
+    {
+        uint32_t slot;
+        if (!reader.get32(&slot) || slot >= _slots.size())
+        {
+            return false;
+        }
+        _free_slots.push_back(slot);
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+#include "output.h"
+
+static thread_local std::ostream *sim_out = NULL;
+
+std::ostream& simOut()
+{
+    return (sim_out != NULL) ? *sim_out : std::cout;
+}
+
+void setSimOut(std::ostream *out)
+{
+    sim_out = out;
+}
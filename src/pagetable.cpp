@@ -1,118 +1,949 @@
 #include <iomanip>
+#include <cstring>
 #include "pagetable.h"
+#include "output.h"
+#include "stats.h"
+#include "snapshot.h"
 
-PageTable::PageTable(int page_size)
+PageTable::PageTable(int page_size, uint64_t memory_size) : PageTable(page_size, new FrameAllocator(memory_size / page_size))
+{
+    _owns_frames = true;
+}
+
+PageTable::PageTable(int page_size, FrameAllocator *frames)
 {
     _page_size = page_size;
+    _large_factor = 1;
+    _frames = frames;
+    _owns_frames = false;
+    _cached_pid = 0;
+    _cached_pages = NULL;
+    _tlb = NULL;
+    _cache = NULL;
+    _analyzer = NULL;
+    _sweep = NULL;
+    _placement = NULL;
+    _reference_log = NULL;
+    _memory = NULL;
+    _swap = NULL;
+    _replacement = NULL;
+    _page_faults = 0;
+    _evictions = 0;
+    _bytes_swapped_in = 0;
+    _bytes_swapped_out = 0;
+    _forked = false;
+    _cow_faults = 0;
 }
 
 PageTable::~PageTable()
 {
+    std::map<uint32_t, ProcessPages>::iterator it;
+    for (it = _table.begin(); it != _table.end(); it++)
+    {
+        for (int i = 0; i < it->second.leaves.size(); i++)
+        {
+            delete[] it->second.leaves[i];
+        }
+    }
+    if (_owns_frames)
+    {
+        delete _frames;
+    }
+}
+
+void PageTable::setTlb(Tlb *tlb)
+{
+    _tlb = tlb;
 }
 
-std::vector<std::string> PageTable::sortedKeys()
+void PageTable::flushTlb(uint32_t pid)
 {
-    std::vector<std::string> keys;
+    if (_tlb != NULL)
+    {
+        _tlb->flushProcess(pid);
+    }
+}
 
-    std::map<std::string, int>::iterator it;
-    for (it = _table.begin(); it != _table.end(); it++)
+void PageTable::setCache(CacheHierarchy *cache)
+{
+    _cache = cache;
+}
+
+CacheHierarchy* PageTable::cache()
+{
+    return _cache;
+}
+
+void PageTable::setAnalyzer(WorkingSetAnalyzer *analyzer)
+{
+    _analyzer = analyzer;
+}
+
+WorkingSetAnalyzer* PageTable::analyzer()
+{
+    return _analyzer;
+}
+
+void PageTable::setSweep(PageSweep *sweep)
+{
+    _sweep = sweep;
+}
+
+PageSweep* PageTable::sweep()
+{
+    return _sweep;
+}
+
+void PageTable::setPlacement(FramePlacement *placement)
+{
+    _placement = placement;
+}
+
+FramePlacement* PageTable::placement()
+{
+    return _placement;
+}
+
+// Writes "<pid> <page>" for every reference the replacement policy is told
+// about, which is the reference string the optimal policy reads
+void PageTable::setReferenceLog(std::ostream *log)
+{
+    _reference_log = log;
+}
+
+void PageTable::enableSwap(void *memory, SwapFile *swap, ReplacementPolicy *replacement)
+{
+    FrameOwner none = {0, 0};
+    _memory = memory;
+    _swap = swap;
+    _replacement = replacement;
+    _owners.assign(_frames->numFrames(), none);
+}
+
+void PageTable::enableLargePages(uint32_t large_page_size)
+{
+    _large_factor = large_page_size / _page_size;
+}
+
+uint32_t PageTable::largePageFactor()
+{
+    return _large_factor;
+}
+
+PageTable::ProcessPages* PageTable::lookupProcess(uint32_t pid)
+{
+    // Translations for the same process tend to arrive back to back
+    if (_cached_pages != NULL && _cached_pid == pid)
+    {
+        return _cached_pages;
+    }
+
+    std::map<uint32_t, ProcessPages>::iterator it = _table.find(pid);
+    if (it == _table.end())
+    {
+        return NULL;
+    }
+
+    _cached_pid = pid;
+    _cached_pages = &it->second;
+    return _cached_pages;
+}
+
+PageTableEntry* PageTable::lookupEntry(uint32_t pid, uint32_t page_number)
+{
+    ProcessPages *pages = lookupProcess(pid);
+    if (pages == NULL)
+    {
+        return NULL;
+    }
+
+    uint32_t dir = page_number >> PT_LEAF_BITS;
+    if (dir >= pages->leaves.size() || pages->leaves[dir] == NULL)
     {
-        keys.push_back(it->first);
+        return NULL;
     }
 
-    std::sort(keys.begin(), keys.end(), PageTableKeyComparator());
+    PageTableEntry *entry = &pages->leaves[dir][page_number & (PT_LEAF_ENTRIES - 1)];
+    return (entry->frame == -1 && entry->swap_slot == -1) ? NULL : entry;
+}
+
+LargePageEntry* PageTable::lookupLarge(ProcessPages *pages, uint32_t page_number)
+{
+    uint32_t index = page_number / _large_factor;
+    if (index >= pages->large.size() || pages->large[index].frame == -1)
+    {
+        return NULL;
+    }
+    return &pages->large[index];
+}
 
-    return keys;
+uint32_t* PageTable::liveBytes(uint32_t pid, uint32_t page_number)
+{
+    ProcessPages *pages = lookupProcess(pid);
+    if (pages == NULL)
+    {
+        return NULL;
+    }
+    LargePageEntry *large = lookupLarge(pages, page_number);
+    if (large != NULL)
+    {
+        return &large->live_bytes;
+    }
+    PageTableEntry *entry = lookupEntry(pid, page_number);
+    return (entry != NULL) ? &entry->live_bytes : NULL;
+}
+
+int PageTable::obtainFrame(uint32_t pid, uint32_t page_number)
+{
+    // Grab the earliest free frame, or the one the placement policy picks,
+    // evicting a victim once memory is full. The victim comes from the frames
+    // the placement policy is allowed to use.
+    int frame = (_placement != NULL) ? _placement->allocate(_frames, pid, page_number) : _frames->allocate();
+    if (frame == -1 && _swap != NULL)
+    {
+        uint32_t first = 0;
+        uint32_t end = _frames->numFrames();
+        if (_placement != NULL)
+        {
+            _placement->victimRange(pid, page_number, &first, &end);
+        }
+        int victim = _replacement->selectVictim(first, end);
+        if (victim != -1)
+        {
+            evictFrame(victim);
+            frame = (_placement != NULL) ? _placement->allocate(_frames, pid, page_number) : _frames->allocate();
+        }
+    }
+    return frame;
+}
+
+void PageTable::evictFrame(int frame)
+{
+    FrameOwner owner = _owners[frame];
+    PageTableEntry *entry = lookupEntry(owner.pid, owner.page_number);
+
+    entry->swap_slot = _swap->writePage((char*)_memory + (size_t)frame * _page_size);
+    entry->frame = -1;
+    if (_tlb != NULL)
+    {
+        _tlb->invalidate(owner.pid, owner.page_number);
+    }
+
+    _replacement->pageReleased(frame);
+    _frames->release(frame);
+    _evictions++;
+    _bytes_swapped_out += _page_size;
 }
 
 void PageTable::addEntry(uint32_t pid, int page_number)
 {
-    // Combination of pid and page number act as the key to look up frame number
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
+    STAT_TIMER(StatAddEntry);
+    if (isMapped(pid, page_number))
+    {
+        return; // already mapped
+    }
 
-    int frame = -1; 
-    const size_t num_frames = 67108864 / _page_size; //not sure how to find this val without hardcoding 
+    int frame = obtainFrame(pid, page_number);
+    if (frame == -1)
+    {
+        simOut() << "error: out of physical frames\n";
+        return;
+    }
 
-    // Find free frame
-    //first, iterate thru pagetable and mark all used frames.
-    std::vector<std::string> keys = sortedKeys();
-    bool marked[num_frames];
-    for(int i = 0; i < num_frames; i++){
-        marked[i] = false;
-	}
+    // Combination of pid and page number index the process's radix table
+    ProcessPages &pages = _table[pid];
+    uint32_t dir = (uint32_t)page_number >> PT_LEAF_BITS;
+    if (dir >= pages.leaves.size())
+    {
+        pages.leaves.resize(dir + 1, NULL);
+    }
+    if (pages.leaves[dir] == NULL)
+    {
+        PageTableEntry empty = {-1, -1, 0};
+        pages.leaves[dir] = new PageTableEntry[PT_LEAF_ENTRIES];
+        std::fill(pages.leaves[dir], pages.leaves[dir] + PT_LEAF_ENTRIES, empty);
+    }
 
-    int min = num_frames + 1;
-    int cur = num_frames + 1;
+    pages.leaves[dir][page_number & (PT_LEAF_ENTRIES - 1)].frame = frame;
+    pages.num_entries++;
 
+    if (_swap != NULL)
+    {
+        FrameOwner owner = {pid, (uint32_t)page_number};
+        _owners[frame] = owner;
+        _replacement->pageLoaded(frame, pid, page_number);
+    }
+}
 
-    for(int i = 0; i < keys.size(); i++){
-        marked[_table[keys[i]]] = true; //mark all frames currently associated with a page
-	}
+bool PageTable::addLargeEntry(uint32_t pid, int page_number)
+{
+    if (_large_factor <= 1 || page_number % _large_factor != 0)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < _large_factor; i++)
+    {
+        if (isMapped(pid, page_number + i))
+        {
+            return false;
+        }
+    }
 
-    int i = 0;
-    while(frame == -1 && i < num_frames){
-        if(marked[i] == false){
-            frame = i; //grab earliest possible unmarked frame  
-		}
-        i++;
-	}
+    // Without an aligned run of free frames the caller falls back to base pages
+    int frame = _frames->allocateRun(_large_factor);
+    if (frame == -1)
+    {
+        return false;
+    }
 
+    ProcessPages &pages = _table[pid];
+    uint32_t index = page_number / _large_factor;
+    if (index >= pages.large.size())
+    {
+        LargePageEntry none = {-1, 0};
+        pages.large.resize(index + 1, none);
+    }
+    pages.large[index].frame = frame;
+    pages.large[index].live_bytes = 0;
+    pages.num_entries++;
+    return true;
+}
 
-    _table[entry] = frame;
+bool PageTable::isMapped(uint32_t pid, int page_number)
+{
+    if (_large_factor > 1)
+    {
+        ProcessPages *pages = lookupProcess(pid);
+        if (pages != NULL && lookupLarge(pages, page_number) != NULL)
+        {
+            return true;
+        }
+    }
+    return lookupEntry(pid, page_number) != NULL;
 }
 
-int PageTable::getPhysicalAddress(uint32_t pid, uint32_t virtual_address)
+int64_t PageTable::getPhysicalAddress(uint32_t pid, uint32_t virtual_address)
 {
+    STAT_TIMER(StatGetPhysicalAddress);
     // Convert virtual address to page_number and page_offset
-    // TODO: implement this!
-    int page_number = 0;
-    int page_offset = 0;
+    uint32_t page_number = virtual_address / _page_size;
+    uint32_t page_offset = virtual_address % _page_size;
+
+    // Consult the TLB first, then fall back to walking the page table
+    int frame = -1;
+    bool large = false;
+    if (_tlb != NULL)
+    {
+        if (_large_factor > 1) {
+            frame = _tlb->lookupMixed(pid, page_number, page_number / _large_factor, &large);
+        } else {
+            frame = _tlb->lookup(pid, page_number);
+        }
+    }
+    if (frame == -1 && _large_factor > 1)
+    {
+        ProcessPages *pages = lookupProcess(pid);
+        LargePageEntry *large_entry = (pages != NULL) ? lookupLarge(pages, page_number) : NULL;
+        if (large_entry != NULL)
+        {
+            large = true;
+            frame = large_entry->frame;
+            if (_tlb != NULL)
+            {
+                _tlb->insert(pid, TLB_LARGE_PAGE | (page_number / _large_factor), frame);
+            }
+        }
+    }
+    if (large)
+    {
+        // Large pages are pinned, so the replacement policy never tracks them
+        frame += page_number % _large_factor;
+        if (_placement != NULL)
+        {
+            _placement->frameAccessed(frame, pid);
+        }
+        return (int64_t)frame * _page_size + page_offset;
+    }
+    if (frame == -1)
+    {
+        PageTableEntry *entry = lookupEntry(pid, page_number);
+        if (entry == NULL)
+        {
+            return -1;
+        }
+
+        if (entry->frame == -1)
+        {
+            // Page fault: bring the page back in from swap
+            frame = obtainFrame(pid, page_number);
+            if (frame == -1)
+            {
+                return -1;
+            }
+            _swap->readPage(entry->swap_slot, (char*)_memory + (size_t)frame * _page_size);
+            _swap->release(entry->swap_slot);
+            entry->swap_slot = -1;
+            entry->frame = frame;
+
+            FrameOwner owner = {pid, page_number};
+            _owners[frame] = owner;
+            _replacement->pageLoaded(frame, pid, page_number);
+            _page_faults++;
+            _bytes_swapped_in += _page_size;
+        }
+
+        frame = entry->frame;
+        if (_tlb != NULL)
+        {
+            _tlb->insert(pid, page_number, frame);
+        }
+    }
+
+    if (_replacement != NULL)
+    {
+        _replacement->pageAccessed(frame, pid, page_number);
+    }
+    if (_reference_log != NULL)
+    {
+        *_reference_log << pid << ' ' << page_number << '\n';
+    }
+    if (_placement != NULL)
+    {
+        _placement->frameAccessed(frame, pid);
+    }
+
+    // Convert virtual to physical address
+    return (int64_t)frame * _page_size + page_offset;
+}
 
-    page_number = virtual_address / _page_size;
-    page_offset  = virtual_address % _page_size;
+// Like getPhysicalAddress, but for a store: a page still shared with a forked
+// process is first copied into a frame of its own
+int64_t PageTable::getWritableAddress(uint32_t pid, uint32_t virtual_address, void *memory)
+{
+    int64_t physical_address = getPhysicalAddress(pid, virtual_address);
+    if (physical_address == -1 || !_forked)
+    {
+        return physical_address;
+    }
+
+    uint32_t page_number = virtual_address / _page_size;
+    ProcessPages *pages = lookupProcess(pid);
+    LargePageEntry *large = (_large_factor > 1) ? lookupLarge(pages, page_number) : NULL;
+    int *frame = (large != NULL) ? &large->frame : &lookupEntry(pid, page_number)->frame;
+    if (_frames->refCount(*frame) <= 1)
+    {
+        return physical_address;
+    }
 
-    // Combination of pid and page number act as the key to look up frame number
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    
-    // If entry exists, look up frame number and convert virtual to physical address
-    int address = -1;
-    if (_table.count(entry) > 0)
+    uint32_t count = (large != NULL) ? _large_factor : 1;
+    int copy = (large != NULL) ? _frames->allocateRun(count) : obtainFrame(pid, page_number);
+    if (copy == -1)
     {
-        address = _table[entry] * _page_size + page_offset;
+        simOut() << "error: out of physical frames\n";
+        return -1;
     }
+    memcpy((char*)memory + (size_t)copy * _page_size, (char*)memory + (size_t)*frame * _page_size, (size_t)count * _page_size);
+    if (large != NULL) {
+        _frames->releaseRun(*frame, count);
+    } else {
+        _frames->release(*frame);
+    }
+    *frame = copy;
+    _cow_faults++;
 
-    return address;
+    uint32_t tlb_page = (large != NULL) ? (TLB_LARGE_PAGE | (page_number / _large_factor)) : page_number;
+    if (_tlb != NULL)
+    {
+        _tlb->invalidate(pid, tlb_page);
+        _tlb->insert(pid, tlb_page, copy);
+    }
+    return (int64_t)(copy + page_number % count) * _page_size + virtual_address % _page_size;
+}
+
+// Maps every page of the parent into the child as well. The frames are
+// shared until one side writes to them (see getWritableAddress); a large
+// page is shared through the first frame of its run.
+void PageTable::forkProcess(uint32_t parent, uint32_t child)
+{
+    ProcessPages *from = lookupProcess(parent);
+    if (from == NULL)
+    {
+        return;
+    }
+
+    ProcessPages &to = _table[child];
+    to.leaves.assign(from->leaves.size(), NULL);
+    to.large = from->large;
+    to.num_entries = from->num_entries;
+    for (int i = 0; i < from->leaves.size(); i++)
+    {
+        if (from->leaves[i] == NULL)
+        {
+            continue;
+        }
+        to.leaves[i] = new PageTableEntry[PT_LEAF_ENTRIES];
+        std::copy(from->leaves[i], from->leaves[i] + PT_LEAF_ENTRIES, to.leaves[i]);
+        for (int j = 0; j < PT_LEAF_ENTRIES; j++)
+        {
+            if (to.leaves[i][j].frame != -1)
+            {
+                _frames->share(to.leaves[i][j].frame);
+            }
+        }
+    }
+    for (int i = 0; i < to.large.size(); i++)
+    {
+        if (to.large[i].frame != -1)
+        {
+            _frames->share(to.large[i].frame);
+        }
+    }
+    _forked = true;
 }
 
 void PageTable::removePageEntry(uint32_t pid, int page_num){
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_num);
-    if (_table.count(entry) > 0)
+    ProcessPages *pages = lookupProcess(pid);
+    if (pages == NULL)
+    {
+        return;
+    }
+
+    // A page inside a large page takes the whole large page with it
+    LargePageEntry *large = lookupLarge(pages, page_num);
+    if (large != NULL)
+    {
+        _frames->releaseRun(large->frame, _large_factor);
+        large->frame = -1;
+        large->live_bytes = 0;
+        if (_tlb != NULL)
+        {
+            _tlb->invalidate(pid, TLB_LARGE_PAGE | (page_num / _large_factor));
+        }
+    }
+    else
+    {
+        PageTableEntry *entry = lookupEntry(pid, page_num);
+        if (entry == NULL)
+        {
+            return;
+        }
+
+        if (entry->frame != -1)
+        {
+            if (_replacement != NULL)
+            {
+                _replacement->pageReleased(entry->frame);
+            }
+            _frames->release(entry->frame);
+        }
+        else
+        {
+            _swap->release(entry->swap_slot);
+        }
+        entry->frame = -1;
+        entry->swap_slot = -1;
+        entry->live_bytes = 0;
+        if (_tlb != NULL)
+        {
+            _tlb->invalidate(pid, page_num);
+        }
+    }
+
+    // Drop the process's table entirely once its last page is gone
+    pages->num_entries--;
+    if (pages->num_entries == 0)
     {
-        _table.erase(entry);
+        for (int i = 0; i < pages->leaves.size(); i++)
+        {
+            delete[] pages->leaves[i];
+        }
+        _table.erase(pid);
+        _cached_pages = NULL;
     }
 }
 
-void PageTable::print()
+void PageTable::addLiveBytes(uint32_t pid, int page_number, uint32_t bytes)
+{
+    uint32_t *live_bytes = liveBytes(pid, page_number);
+    if (live_bytes != NULL)
+    {
+        *live_bytes += bytes;
+    }
+}
+
+void PageTable::removeLiveBytes(uint32_t pid, int page_number, uint32_t bytes)
+{
+    uint32_t *live_bytes = liveBytes(pid, page_number);
+    if (live_bytes == NULL)
+    {
+        return;
+    }
+
+    *live_bytes -= std::min(bytes, *live_bytes);
+    if (*live_bytes == 0)
+    {
+        removePageEntry(pid, page_number);
+    }
+}
+
+void PageTable::removeProcess(uint32_t pid)
+{
+    if (_analyzer != NULL)
+    {
+        _analyzer->processExited(pid);
+    }
+    if (_sweep != NULL)
+    {
+        _sweep->processExited(pid);
+    }
+    std::map<uint32_t, ProcessPages>::iterator it = _table.find(pid);
+    if (it == _table.end())
+    {
+        return;
+    }
+
+    // Hand back every frame and swap slot in one walk over the radix table
+    std::vector<PageTableEntry*> &leaves = it->second.leaves;
+    for (int dir = 0; dir < leaves.size(); dir++)
+    {
+        if (leaves[dir] == NULL)
+        {
+            continue;
+        }
+        for (int i = 0; i < PT_LEAF_ENTRIES; i++)
+        {
+            PageTableEntry *entry = &leaves[dir][i];
+            if (entry->frame != -1)
+            {
+                if (_replacement != NULL)
+                {
+                    _replacement->pageReleased(entry->frame);
+                }
+                _frames->release(entry->frame);
+            }
+            else if (entry->swap_slot != -1)
+            {
+                _swap->release(entry->swap_slot);
+            }
+        }
+        delete[] leaves[dir];
+    }
+    std::vector<LargePageEntry> &large = it->second.large;
+    for (int i = 0; i < large.size(); i++)
+    {
+        if (large[i].frame != -1)
+        {
+            _frames->releaseRun(large[i].frame, _large_factor);
+        }
+    }
+
+    _table.erase(it);
+    _cached_pages = NULL;
+    flushTlb(pid);
+}
+
+void PageTable::clear()
+{
+    std::vector<uint32_t> pids;
+    std::map<uint32_t, ProcessPages>::iterator it;
+    for (it = _table.begin(); it != _table.end(); it++)
+    {
+        pids.push_back(it->first);
+    }
+    for (int i = 0; i < pids.size(); i++)
+    {
+        removeProcess(pids[i]);
+    }
+}
+
+uint64_t PageTable::pageFaults()
+{
+    return _page_faults;
+}
+
+uint32_t PageTable::framesInUse()
 {
-    int i;
-    std::vector<std::string> keys = sortedKeys();
+    return _frames->numFrames() - _frames->numFree();
+}
 
+uint32_t PageTable::numFrames()
+{
+    return _frames->numFrames();
+}
+
+uint32_t PageTable::sharedFrames()
+{
+    return _frames->numShared();
+}
+
+uint64_t PageTable::cowFaults()
+{
+    return _cow_faults;
+}
+
+void PageTable::print()
+{
     std::cout << " PID  | Page Number | Frame Number" << std::endl;
     std::cout << "------+-------------+--------------" << std::endl;
 
-    for (i = 0; i < keys.size(); i++)
+    // std::map keeps pids ordered and each radix table is walked by page number
+    std::map<uint32_t, ProcessPages>::iterator it;
+    for (it = _table.begin(); it != _table.end(); it++)
+    {
+        uint32_t next_large = 0;
+        for (int i = 0; i < it->second.leaves.size(); i++)
+        {
+            PageTableEntry *leaf = it->second.leaves[i];
+            if (leaf == NULL)
+            {
+                continue;
+            }
+            for (int j = 0; j < PT_LEAF_ENTRIES; j++)
+            {
+                if (leaf[j].frame == -1 && leaf[j].swap_slot == -1)
+                {
+                    continue;
+                }
+                int pagenum = (i << PT_LEAF_BITS) + j;
+                printLargeRows(it->first, it->second, pagenum, &next_large);
+                std::cout << std::setw(5) << it->first << " | " << std::setw(11) << pagenum << " | ";
+                if (leaf[j].frame != -1) {
+                    std::cout << std::setw(12) << leaf[j].frame << '\n';
+                } else {
+                    std::cout << std::setw(12) << "swapped" << '\n';
+                }
+            }
+        }
+        printLargeRows(it->first, it->second, UINT64_MAX, &next_large);
+    }
+}
+
+// Prints the large pages of a process that start before page `before`, as
+// page and frame ranges, continuing from large page number *next
+void PageTable::printLargeRows(uint32_t pid, ProcessPages &pages, uint64_t before, uint32_t *next)
+{
+    for (; *next < pages.large.size() && (uint64_t)*next * _large_factor < before; (*next)++)
+    {
+        int frame = pages.large[*next].frame;
+        if (frame == -1)
+        {
+            continue;
+        }
+        uint32_t first = *next * _large_factor;
+        std::string page_range = std::to_string(first) + "-" + std::to_string(first + _large_factor - 1);
+        std::string frame_range = std::to_string(frame) + "-" + std::to_string(frame + _large_factor - 1);
+        std::cout << std::setw(5) << pid << " | " << std::setw(11) << page_range << " | " << std::setw(12) << frame_range << '\n';
+    }
+}
+
+void PageTable::printSwap()
+{
+    std::cout << "Replacement policy | " << _replacement->name() << '\n';
+    std::cout << "Frames in use      | " << _frames->numFrames() - _frames->numFree() << " / " << _frames->numFrames() << '\n';
+    std::cout << "Page faults        | " << _page_faults << '\n';
+    std::cout << "Evictions          | " << _evictions << '\n';
+    std::cout << "Bytes swapped in   | " << _bytes_swapped_in << '\n';
+    std::cout << "Bytes swapped out  | " << _bytes_swapped_out << '\n';
+    std::cout << "Swap slots in use  | " << _swap->slotsInUse() << '\n';
+}
+
+void PageTable::printPlacement()
+{
+    _placement->print(_frames);
+}
+
+void PageTable::printLargePages()
+{
+    uint64_t large_pages = 0;
+    std::map<uint32_t, ProcessPages>::iterator it;
+    for (it = _table.begin(); it != _table.end(); it++)
+    {
+        for (int i = 0; i < it->second.large.size(); i++)
+        {
+            if (it->second.large[i].frame != -1)
+            {
+                large_pages++;
+            }
+        }
+    }
+
+    // Each large page stands in for _large_factor base entries, in the page
+    // table and in the TLB alike
+    std::cout << "Large page size          | " << (uint64_t)_large_factor * _page_size << " (" << _large_factor << " pages)" << '\n';
+    std::cout << "Large pages mapped       | " << large_pages << '\n';
+    std::cout << "Page table entries saved | " << large_pages * (_large_factor - 1) << '\n';
+    if (_tlb != NULL)
+    {
+        uint32_t valid, large;
+        _tlb->countEntries(&valid, &large);
+        uint64_t reach = ((uint64_t)(valid - large) + (uint64_t)large * _large_factor) * _page_size;
+        std::cout << "TLB reach                | " << reach << " bytes (" << (uint64_t)valid * _page_size << " with base pages only)" << '\n';
+    }
+}
+
+// Every resident page is saved with its frame number and contents, so a
+// restore puts each page back in the frame it came from. A frame shared after
+// a fork carries its contents only the first time it is written. Swapped
+// pages are not supported; saveSnapshot refuses to run with swap enabled.
+void PageTable::save(SnapshotWriter &writer, void *memory)
+{
+    std::vector<bool> written(_frames->numFrames(), false);
+    writer.put32(_table.size());
+    std::map<uint32_t, ProcessPages>::iterator it;
+    for (it = _table.begin(); it != _table.end(); it++)
+    {
+        ProcessPages &pages = it->second;
+        uint32_t num_base = pages.num_entries;
+        for (int i = 0; i < pages.large.size(); i++)
+        {
+            num_base -= (pages.large[i].frame != -1);
+        }
+
+        writer.put32(it->first);
+        writer.put32(num_base);
+        for (int i = 0; i < pages.leaves.size(); i++)
+        {
+            PageTableEntry *leaf = pages.leaves[i];
+            for (int j = 0; leaf != NULL && j < PT_LEAF_ENTRIES; j++)
+            {
+                if (leaf[j].frame == -1)
+                {
+                    continue;
+                }
+                writer.put32((i << PT_LEAF_BITS) + j);
+                writer.put32(leaf[j].frame);
+                writer.put32(leaf[j].live_bytes);
+                writer.put8(!written[leaf[j].frame]);
+                if (!written[leaf[j].frame])
+                {
+                    writer.putBytes((char*)memory + (size_t)leaf[j].frame * _page_size, _page_size);
+                    written[leaf[j].frame] = true;
+                }
+            }
+        }
+
+        writer.put32(pages.num_entries - num_base);
+        for (int i = 0; i < pages.large.size(); i++)
+        {
+            if (pages.large[i].frame == -1)
+            {
+                continue;
+            }
+            writer.put32(i);
+            writer.put32(pages.large[i].frame);
+            writer.put32(pages.large[i].live_bytes);
+            writer.put8(!written[pages.large[i].frame]);
+            if (!written[pages.large[i].frame])
+            {
+                writer.putBytes((char*)memory + (size_t)pages.large[i].frame * _page_size, _large_factor * _page_size);
+                written[pages.large[i].frame] = true;
+            }
+        }
+    }
+}
+
+// Expects an empty page table (see clear())
+bool PageTable::load(SnapshotReader &reader, void *memory)
+{
+    uint32_t num_processes;
+    if (!reader.get32(&num_processes))
+    {
+        return false;
+    }
+    for (uint32_t p = 0; p < num_processes; p++)
     {
-        // TODO: print all pages
-        size_t found = keys[i].find("|");
-        if(found == std::string::npos){
-             std::cout << "error in key formatting. " << '\n';
-             break;
-		}
+        uint32_t pid, num_base, num_large;
+        if (!reader.get32(&pid) || !reader.get32(&num_base))
+        {
+            return false;
+        }
+        ProcessPages &pages = _table[pid];
+        pages.num_entries = 0;
+        _cached_pages = NULL;
 
-        std::string pid = keys[i].substr(0, found);
-        int pagenum = stoi(keys[i].substr(found + 1, keys[i].size() - (found))) - 1; //hacked to zero-index??
-        int framenum = _table[keys[i]];
+        for (uint32_t i = 0; i < num_base; i++)
+        {
+            uint32_t page_number, frame, live_bytes;
+            uint8_t has_contents;
+            const char *contents = NULL;
+            if (!reader.get32(&page_number) || !reader.get32(&frame) || !reader.get32(&live_bytes) || !reader.get8(&has_contents)
+             || (has_contents && ((contents = reader.getBytes(_page_size)) == NULL || !_frames->claim(frame))))
+            {
+                return false;
+            }
+            if (!has_contents)
+            {
+                // Shared with a page loaded earlier in the snapshot
+                if (frame >= _frames->numFrames() || _frames->isFree(frame))
+                {
+                    return false;
+                }
+                _frames->share(frame);
+                _forked = true;
+            }
+            uint32_t dir = page_number >> PT_LEAF_BITS;
+            if (dir >= pages.leaves.size())
+            {
+                pages.leaves.resize(dir + 1, NULL);
+            }
+            if (pages.leaves[dir] == NULL)
+            {
+                PageTableEntry empty = {-1, -1, 0};
+                pages.leaves[dir] = new PageTableEntry[PT_LEAF_ENTRIES];
+                std::fill(pages.leaves[dir], pages.leaves[dir] + PT_LEAF_ENTRIES, empty);
+            }
+            PageTableEntry entry = {(int)frame, -1, live_bytes};
+            pages.leaves[dir][page_number & (PT_LEAF_ENTRIES - 1)] = entry;
+            pages.num_entries++;
+            if (contents != NULL)
+            {
+                memcpy((char*)memory + (size_t)frame * _page_size, contents, _page_size);
+            }
+        }
 
-        std::cout << std::setw(5) << pid << " | " << std::setw(11) << pagenum << " | " << std::setw(12) << framenum << '\n';
+        if (!reader.get32(&num_large))
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < num_large; i++)
+        {
+            uint32_t index, frame, live_bytes;
+            uint8_t has_contents;
+            const char *contents = NULL;
+            if (!reader.get32(&index) || !reader.get32(&frame) || !reader.get32(&live_bytes) || !reader.get8(&has_contents)
+             || (has_contents && (contents = reader.getBytes((uint64_t)_large_factor * _page_size)) == NULL))
+            {
+                return false;
+            }
+            for (uint32_t f = 0; has_contents && f < _large_factor; f++)
+            {
+                if (!_frames->claim(frame + f))
+                {
+                    return false;
+                }
+            }
+            if (!has_contents)
+            {
+                if (frame >= _frames->numFrames() || _frames->isFree(frame))
+                {
+                    return false;
+                }
+                _frames->share(frame);
+                _forked = true;
+            }
+            if (index >= pages.large.size())
+            {
+                LargePageEntry none = {-1, 0};
+                pages.large.resize(index + 1, none);
+            }
+            LargePageEntry entry = {(int)frame, live_bytes};
+            pages.large[index] = entry;
+            pages.num_entries++;
+            if (contents != NULL)
+            {
+                memcpy((char*)memory + (size_t)frame * _page_size, contents, (size_t)_large_factor * _page_size);
+            }
+        }
     }
+    return true;
 }
@@ -0,0 +1,347 @@
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/mman.h>
+#include "parallelreplay.h"
+#include "command.h"
+
+// Commands handed out between two points where every worker has caught up
+#define REPLAY_EPOCH_COMMANDS 8192
+
+// Slot of a job that starts no process
+#define REPLAY_NO_SLOT UINT32_MAX
+
+typedef struct ReplayJob {
+    const char *line;
+    const char *end;
+    uint32_t slot; // slot and generation of the process a create or fork starts
+    uint32_t generation;
+} ReplayJob;
+
+// The process slots of a single MMU, kept by the dispatcher so that every new
+// process gets the slot, and so the PID, a serial replay would give it
+typedef struct ReplaySlots {
+    std::vector<uint32_t> generations;
+    std::vector<int> owners; // shard holding the slot's process, or -1 if vacant
+    std::vector<uint32_t> free_slots;
+} ReplaySlots;
+
+typedef struct ReplayWorker {
+    Simulator *sim;
+    std::vector<ReplayJob> jobs;
+    std::vector<size_t> output_ends; // where each job's output stops in `output`
+    std::ostringstream output;
+    std::thread thread;
+} ReplayWorker;
+
+typedef struct ReplayState {
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    uint64_t epoch;
+    int pending;
+    bool stopping;
+} ReplayState;
+
+static void workerLoop(ReplayState *state, ReplayWorker *worker)
+{
+    setSimOut(&worker->output);
+    std::vector<Token> args;
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(state->lock);
+            while (state->epoch == seen && !state->stopping)
+            {
+                state->start.wait(guard);
+            }
+            if (state->epoch == seen)
+            {
+                return;
+            }
+            seen = state->epoch;
+        }
+
+        for (int i = 0; i < worker->jobs.size(); i++)
+        {
+            ReplayJob &job = worker->jobs[i];
+            if (job.slot != REPLAY_NO_SLOT)
+            {
+                worker->sim->mmu->assignSlot(job.slot, job.generation);
+            }
+            tokenize(job.line, job.end, args);
+            executeCommand(args, worker->sim);
+            worker->output_ends.push_back(worker->output.tellp());
+        }
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (--state->pending == 0)
+        {
+            state->done.notify_one();
+        }
+    }
+}
+
+// Lets every worker run its queued jobs, then writes their output in the
+// order the commands appeared in the trace
+static void runEpoch(ReplayState *state, std::vector<ReplayWorker*> &workers, std::vector<uint32_t> &owners)
+{
+    if (owners.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->pending = workers.size();
+        state->epoch++;
+    }
+    state->start.notify_all();
+    {
+        std::unique_lock<std::mutex> guard(state->lock);
+        while (state->pending > 0)
+        {
+            state->done.wait(guard);
+        }
+    }
+
+    std::vector<std::string> text(workers.size());
+    std::vector<size_t> position(workers.size(), 0);
+    std::vector<size_t> next(workers.size(), 0);
+    for (int i = 0; i < workers.size(); i++)
+    {
+        text[i] = workers[i]->output.str();
+    }
+    for (int i = 0; i < owners.size(); i++)
+    {
+        uint32_t shard = owners[i];
+        size_t end = workers[shard]->output_ends[next[shard]++];
+        std::cout.write(text[shard].data() + position[shard], end - position[shard]);
+        position[shard] = end;
+    }
+
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->jobs.clear();
+        workers[i]->output_ends.clear();
+        workers[i]->output.str("");
+    }
+    owners.clear();
+}
+
+// Splits off at most `max` leading words without tokenizing the whole line
+static uint32_t peekTokens(const char *line, const char *end, Token *tokens, uint32_t max)
+{
+    uint32_t count = 0;
+    const char *p = line;
+    while (p < end && count < max)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            p++;
+        }
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        {
+            p++;
+        }
+        if (p > start)
+        {
+            tokens[count].text = start;
+            tokens[count].length = p - start;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Takes a slot the way Mmu::newProcess does: the most recently vacated one first
+static uint32_t claimSlot(ReplaySlots *slots)
+{
+    uint32_t slot;
+    if (slots->free_slots.size() > 0)
+    {
+        slot = slots->free_slots.back();
+        slots->free_slots.pop_back();
+    }
+    else
+    {
+        slot = slots->generations.size();
+        slots->generations.push_back(0);
+        slots->owners.push_back(-1);
+    }
+    return slot;
+}
+
+// Returns the slot of a live process, or -1 for a pid no shard would find
+static int64_t findSlot(ReplaySlots *slots, uint32_t pid)
+{
+    if (pid < PID_BASE)
+    {
+        return -1;
+    }
+    uint32_t slot = (pid - PID_BASE) & PID_SLOT_MASK;
+    uint32_t generation = (pid - PID_BASE) >> PID_SLOT_BITS;
+    if (slot >= slots->owners.size() || slots->owners[slot] == -1 || slots->generations[slot] != generation)
+    {
+        return -1;
+    }
+    return slot;
+}
+
+// Returns the shard a command runs on, or -1 if it looks at every shard. A
+// create or fork also takes its process's slot, a terminate frees it.
+static int routeCommand(Token *head, uint32_t count, uint32_t num_shards, ReplaySlots *slots, ReplayJob *job)
+{
+    long value;
+    job->slot = REPLAY_NO_SLOT;
+    if (tokenEquals(head[0], "create"))
+    {
+        long data_size;
+        if (count < 3 || !parseLong(head[1], &value) || !parseLong(head[2], &data_size))
+        {
+            return 0;
+        }
+        // New processes go to the shard congruent to their slot, which spreads them evenly
+        job->slot = claimSlot(slots);
+        job->generation = slots->generations[job->slot];
+        slots->owners[job->slot] = job->slot % num_shards;
+        return slots->owners[job->slot];
+    }
+    if (tokenEquals(head[0], "print") && count > 1)
+    {
+        const char *colon = (const char*)memchr(head[1].text, ':', head[1].length);
+        if (colon == NULL)
+        {
+            return -1;
+        }
+        Token pid_token = {head[1].text, (uint32_t)(colon - head[1].text)};
+        head[1] = pid_token;
+    }
+    if (count < 2 || !parseLong(head[1], &value))
+    {
+        return 0; // malformed commands only print an error, so any shard will do
+    }
+
+    int64_t slot = findSlot(slots, value);
+    if (slot == -1)
+    {
+        return 0; // every shard reports the process as missing
+    }
+    int shard = slots->owners[slot];
+    if (tokenEquals(head[0], "terminate"))
+    {
+        // Vacated as in Mmu::killProcess
+        slots->owners[slot] = -1;
+        slots->generations[slot] = (slots->generations[slot] + 1) & ((1u << (32 - PID_SLOT_BITS)) - 1);
+        slots->free_slots.push_back(slot);
+    }
+    else if (tokenEquals(head[0], "fork"))
+    {
+        // The child shares frames with its parent, so it stays on the parent's shard
+        job->slot = claimSlot(slots);
+        job->generation = slots->generations[job->slot];
+        slots->owners[job->slot] = shard;
+    }
+    return shard;
+}
+
+long runTraceParallel(std::string path, std::vector<Simulator*> &shards)
+{
+    const char *data;
+    size_t size;
+    if (!mapTrace(path, &data, &size))
+    {
+        return -1;
+    }
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    ReplayState state;
+    state.epoch = 0;
+    state.pending = 0;
+    state.stopping = false;
+
+    std::vector<ReplayWorker*> workers;
+    for (int i = 0; i < shards.size(); i++)
+    {
+        ReplayWorker *worker = new ReplayWorker();
+        worker->sim = shards[i];
+        worker->jobs.reserve(REPLAY_EPOCH_COMMANDS);
+        workers.push_back(worker);
+    }
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->thread = std::thread(workerLoop, &state, workers[i]);
+    }
+
+    std::vector<uint32_t> owners; // shard of each command in the current epoch
+    owners.reserve(REPLAY_EPOCH_COMMANDS);
+    std::vector<Token> args;
+    Token head[3];
+    ReplaySlots slots;
+    long num_commands_run = 0;
+    const char *end = data + size;
+    const char *line = data;
+    while (line < end)
+    {
+        const char *newline = (const char*)memchr(line, '\n', end - line);
+        const char *line_end = (newline != NULL) ? newline : end;
+        uint32_t count = peekTokens(line, line_end, head, 3);
+        if (count > 0 && head[0].text[0] != '#')
+        {
+            num_commands_run++;
+            if (tokenEquals(head[0], "exit"))
+            {
+                break;
+            }
+
+            ReplayJob job = {line, line_end};
+            int shard = routeCommand(head, count, shards.size(), &slots, &job);
+            if (shard == -1)
+            {
+                // Whole-machine commands see every earlier command's effects
+                runEpoch(&state, workers, owners);
+                tokenize(line, line_end, args);
+                for (int i = 0; i < shards.size(); i++)
+                {
+                    if (shards.size() > 1)
+                    {
+                        std::cout << "[shard " << i << "]" << '\n';
+                    }
+                    executeCommand(args, shards[i]);
+                }
+            }
+            else
+            {
+                workers[shard]->jobs.push_back(job);
+                owners.push_back(shard);
+                if (owners.size() == REPLAY_EPOCH_COMMANDS)
+                {
+                    runEpoch(&state, workers, owners);
+                }
+            }
+        }
+        line = line_end + 1;
+    }
+    runEpoch(&state, workers, owners);
+
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.stopping = true;
+    }
+    state.start.notify_all();
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->thread.join();
+        delete workers[i];
+    }
+
+    munmap((void*)data, size);
+    return num_commands_run;
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include "placement.h"
+
+FramePlacement* FramePlacement::create(std::string name, uint32_t count, uint32_t num_frames)
+{
+    if (count == 0 || count > num_frames)
+    {
+        return NULL;
+    }
+    if (name == "color") {
+        // Colors select frames by residue, which the allocator needs to be a power of two
+        return ((count & (count - 1)) == 0) ? new ColorPlacement(count) : NULL;
+    } else if (name == "first-touch") {
+        return new NumaPlacement(NumaFirstTouch, count, num_frames);
+    } else if (name == "interleave") {
+        return new NumaPlacement(NumaInterleave, count, num_frames);
+    } else if (name == "bind") {
+        return new NumaPlacement(NumaBind, count, num_frames);
+    }
+    return NULL;
+}
+
+ColorPlacement::ColorPlacement(uint32_t colors)
+{
+    _colors = colors;
+    _fallbacks = 0;
+}
+
+const char* ColorPlacement::name()
+{
+    return "color";
+}
+
+int ColorPlacement::allocate(FrameAllocator *frames, uint32_t pid, uint32_t page_number)
+{
+    // Offsetting by pid keeps the first pages of every process off the same sets
+    uint32_t color = (page_number + pid) % _colors;
+    int frame = frames->allocateIn(0, frames->numFrames(), _colors, color);
+    if (frame == -1)
+    {
+        frame = frames->allocate();
+        _fallbacks += (frame != -1);
+    }
+    return frame;
+}
+
+void ColorPlacement::print(FrameAllocator *frames)
+{
+    std::vector<uint32_t> in_use(_colors, 0);
+    for (uint32_t frame = 0; frame < frames->numFrames(); frame++)
+    {
+        in_use[frame % _colors] += !frames->isFree(frame);
+    }
+
+    std::cout << "Placement: page coloring, " << _colors << " colors" << '\n';
+    std::cout << "Pages placed off their color: " << _fallbacks << '\n';
+    std::cout << " Color | Frames in use" << '\n';
+    std::cout << "-------+--------------" << '\n';
+    for (uint32_t color = 0; color < _colors; color++)
+    {
+        std::cout << std::setw(6) << color << " | " << std::setw(12) << in_use[color] << '\n';
+    }
+}
+
+NumaPlacement::NumaPlacement(NumaPolicy policy, uint32_t num_nodes, uint32_t num_frames)
+{
+    _policy = policy;
+    _num_nodes = num_nodes;
+    _num_frames = num_frames;
+    _local_accesses.assign(num_nodes, 0);
+    _remote_accesses.assign(num_nodes, 0);
+    _fallbacks = 0;
+}
+
+const char* NumaPlacement::name()
+{
+    const char *names[] = {"first-touch", "interleave", "bind"};
+    return names[_policy];
+}
+
+// Node n holds frames [nodeStart(n), nodeStart(n + 1))
+uint32_t NumaPlacement::nodeStart(uint32_t node)
+{
+    return (uint64_t)node * _num_frames / _num_nodes;
+}
+
+uint32_t NumaPlacement::nodeOf(int frame)
+{
+    uint32_t node = (uint64_t)frame * _num_nodes / _num_frames;
+    while (node + 1 < _num_nodes && (uint32_t)frame >= nodeStart(node + 1))
+    {
+        node++;
+    }
+    while ((uint32_t)frame < nodeStart(node))
+    {
+        node--;
+    }
+    return node;
+}
+
+int NumaPlacement::allocate(FrameAllocator *frames, uint32_t pid, uint32_t page_number)
+{
+    uint32_t node = (_policy == NumaInterleave) ? page_number % _num_nodes : pid % _num_nodes;
+    int frame = frames->allocateIn(nodeStart(node), nodeStart(node + 1), 1, 0);
+    if (frame != -1 || _policy == NumaBind)
+    {
+        return frame;
+    }
+
+    // The preferred node is full: try the others in order
+    for (uint32_t i = 1; i < _num_nodes && frame == -1; i++)
+    {
+        uint32_t other = (node + i) % _num_nodes;
+        frame = frames->allocateIn(nodeStart(other), nodeStart(other + 1), 1, 0);
+    }
+    _fallbacks += (frame != -1);
+    return frame;
+}
+
+void NumaPlacement::frameAccessed(int frame, uint32_t pid)
+{
+    uint32_t node = nodeOf(frame);
+    if (node == pid % _num_nodes) {
+        _local_accesses[node]++;
+    } else {
+        _remote_accesses[node]++;
+    }
+}
+
+void NumaPlacement::victimRange(uint32_t pid, uint32_t page_number, uint32_t *first, uint32_t *end)
+{
+    if (_policy == NumaBind)
+    {
+        *first = nodeStart(pid % _num_nodes);
+        *end = nodeStart(pid % _num_nodes + 1);
+    }
+}
+
+void NumaPlacement::print(FrameAllocator *frames)
+{
+    std::cout << "Placement: " << name() << ", " << _num_nodes << " nodes (process pid runs on node pid % " << _num_nodes << ")" << '\n';
+    std::cout << "Pages placed off their node: " << _fallbacks << '\n';
+    std::cout << " Node |     Frames |     In use |      Local |     Remote" << '\n';
+    std::cout << "------+------------+------------+------------+-----------" << '\n';
+    for (uint32_t node = 0; node < _num_nodes; node++)
+    {
+        uint32_t in_use = 0;
+        for (uint32_t frame = nodeStart(node); frame < nodeStart(node + 1); frame++)
+        {
+            in_use += !frames->isFree(frame);
+        }
+        std::cout << std::setw(5) << node << " | " << std::setw(10) << nodeStart(node + 1) - nodeStart(node) << " | "
+                  << std::setw(10) << in_use << " | " << std::setw(10) << _local_accesses[node] << " | "
+                  << std::setw(10) << _remote_accesses[node] << '\n';
+    }
+}
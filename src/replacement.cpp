@@ -0,0 +1,289 @@
+#include <fstream>
+#include "replacement.h"
+
+#define PAGE_KEY(pid, page) (((uint64_t)(pid) << 32) | (page))
+
+ReplacementPolicy* ReplacementPolicy::create(std::string name, uint32_t num_frames, std::string reference_file)
+{
+    if (name == "fifo") {
+        return new FifoReplacement(num_frames);
+    } else if (name == "lru") {
+        return new LruReplacement(num_frames);
+    } else if (name == "clock") {
+        return new ClockReplacement(num_frames);
+    } else if (name == "optimal") {
+        OptimalReplacement *opt = new OptimalReplacement(num_frames, reference_file);
+        if (!opt->loaded())
+        {
+            delete opt;
+            return NULL;
+        }
+        return opt;
+    }
+    return NULL;
+}
+
+FrameList::FrameList(uint32_t num_frames) : _prev(num_frames, -2), _next(num_frames, -2)
+{
+    _head = -1;
+    _tail = -1;
+}
+
+bool FrameList::contains(int frame)
+{
+    return _prev[frame] != -2;
+}
+
+void FrameList::pushBack(int frame)
+{
+    _prev[frame] = _tail;
+    _next[frame] = -1;
+    if (_tail != -1)
+    {
+        _next[_tail] = frame;
+    }
+    else
+    {
+        _head = frame;
+    }
+    _tail = frame;
+}
+
+void FrameList::remove(int frame)
+{
+    if (!contains(frame))
+    {
+        return;
+    }
+
+    if (_prev[frame] != -1) {
+        _next[_prev[frame]] = _next[frame];
+    } else {
+        _head = _next[frame];
+    }
+    if (_next[frame] != -1) {
+        _prev[_next[frame]] = _prev[frame];
+    } else {
+        _tail = _prev[frame];
+    }
+    _prev[frame] = -2;
+    _next[frame] = -2;
+}
+
+int FrameList::front()
+{
+    return _head;
+}
+
+int FrameList::next(int frame)
+{
+    return _next[frame];
+}
+
+FifoReplacement::FifoReplacement(uint32_t num_frames) : _queue(num_frames)
+{
+}
+
+const char* FifoReplacement::name()
+{
+    return "fifo";
+}
+
+void FifoReplacement::pageLoaded(int frame, uint32_t pid, uint32_t page_number)
+{
+    _queue.remove(frame);
+    _queue.pushBack(frame);
+}
+
+void FifoReplacement::pageAccessed(int frame, uint32_t pid, uint32_t page_number)
+{
+}
+
+void FifoReplacement::pageReleased(int frame)
+{
+    _queue.remove(frame);
+}
+
+int FifoReplacement::selectVictim(uint32_t first, uint32_t end)
+{
+    int frame = _queue.front();
+    while (frame != -1 && ((uint32_t)frame < first || (uint32_t)frame >= end))
+    {
+        frame = _queue.next(frame);
+    }
+    return frame;
+}
+
+LruReplacement::LruReplacement(uint32_t num_frames) : _recency(num_frames)
+{
+}
+
+const char* LruReplacement::name()
+{
+    return "lru";
+}
+
+void LruReplacement::pageLoaded(int frame, uint32_t pid, uint32_t page_number)
+{
+    _recency.remove(frame);
+    _recency.pushBack(frame);
+}
+
+void LruReplacement::pageAccessed(int frame, uint32_t pid, uint32_t page_number)
+{
+    _recency.remove(frame);
+    _recency.pushBack(frame);
+}
+
+void LruReplacement::pageReleased(int frame)
+{
+    _recency.remove(frame);
+}
+
+int LruReplacement::selectVictim(uint32_t first, uint32_t end)
+{
+    int frame = _recency.front();
+    while (frame != -1 && ((uint32_t)frame < first || (uint32_t)frame >= end))
+    {
+        frame = _recency.next(frame);
+    }
+    return frame;
+}
+
+ClockReplacement::ClockReplacement(uint32_t num_frames) : _resident(num_frames, 0), _referenced(num_frames, 0)
+{
+    _hand = 0;
+}
+
+const char* ClockReplacement::name()
+{
+    return "clock";
+}
+
+void ClockReplacement::pageLoaded(int frame, uint32_t pid, uint32_t page_number)
+{
+    _resident[frame] = 1;
+    _referenced[frame] = 1;
+}
+
+void ClockReplacement::pageAccessed(int frame, uint32_t pid, uint32_t page_number)
+{
+    _referenced[frame] = 1;
+}
+
+void ClockReplacement::pageReleased(int frame)
+{
+    _resident[frame] = 0;
+    _referenced[frame] = 0;
+}
+
+int ClockReplacement::selectVictim(uint32_t first, uint32_t end)
+{
+    // Sweep at most twice: the first pass may only clear reference bits.
+    // Frames outside the range keep their bits.
+    for (uint32_t i = 0; i < 2 * _resident.size(); i++)
+    {
+        uint32_t frame = _hand;
+        _hand = (_hand + 1) % _resident.size();
+        if (!_resident[frame] || frame < first || frame >= end)
+        {
+            continue;
+        }
+        if (_referenced[frame])
+        {
+            _referenced[frame] = 0;
+        }
+        else
+        {
+            return frame;
+        }
+    }
+    return -1;
+}
+
+OptimalReplacement::OptimalReplacement(uint32_t num_frames, std::string reference_file) : _frame_keys(num_frames, 0), _resident(num_frames, 0)
+{
+    _time = 0;
+
+    std::ifstream refs(reference_file.c_str());
+    if (!refs.is_open())
+    {
+        return;
+    }
+
+    uint32_t pid, page_number;
+    uint64_t position = 0;
+    while (refs >> pid >> page_number)
+    {
+        FutureUses &uses = _future[PAGE_KEY(pid, page_number)];
+        uses.positions.push_back(position);
+        position++;
+    }
+}
+
+bool OptimalReplacement::loaded()
+{
+    return _future.size() > 0;
+}
+
+const char* OptimalReplacement::name()
+{
+    return "optimal";
+}
+
+uint64_t OptimalReplacement::nextUse(uint64_t key)
+{
+    std::unordered_map<uint64_t, FutureUses>::iterator it = _future.find(key);
+    if (it == _future.end())
+    {
+        return UINT64_MAX; // never referenced again
+    }
+
+    FutureUses &uses = it->second;
+    while (uses.cursor < uses.positions.size() && uses.positions[uses.cursor] < _time)
+    {
+        uses.cursor++;
+    }
+    return (uses.cursor < uses.positions.size()) ? uses.positions[uses.cursor] : UINT64_MAX;
+}
+
+void OptimalReplacement::pageLoaded(int frame, uint32_t pid, uint32_t page_number)
+{
+    _frame_keys[frame] = PAGE_KEY(pid, page_number);
+    _resident[frame] = 1;
+}
+
+void OptimalReplacement::pageAccessed(int frame, uint32_t pid, uint32_t page_number)
+{
+    _time++;
+}
+
+void OptimalReplacement::pageReleased(int frame)
+{
+    _resident[frame] = 0;
+}
+
+int OptimalReplacement::selectVictim(uint32_t first, uint32_t end)
+{
+    // Evict the resident page whose next reference lies furthest in the future
+    int victim = -1;
+    uint64_t furthest = 0;
+    for (uint32_t frame = first; frame < end && frame < _resident.size(); frame++)
+    {
+        if (!_resident[frame])
+        {
+            continue;
+        }
+        uint64_t next = nextUse(_frame_keys[frame]);
+        if (victim == -1 || next > furthest)
+        {
+            victim = frame;
+            furthest = next;
+        }
+        if (next == UINT64_MAX)
+        {
+            break;
+        }
+    }
+    return victim;
+}
@@ -0,0 +1,357 @@
+#include <cstring>
+#include <math.h>
+#include <algorithm>
+#include "simulator.h"
+#include "stats.h"
+
+std::atomic<int64_t> mem_utilization(0);
+uint64_t memory_size = 67108864;
+bool swap_enabled = false;
+
+void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table, int page_size)
+{
+    STAT_TIMER(StatCreateProcess);
+    // TODO: implement this!
+    //   - create new process in the MMU
+    uint32_t PID = mmu->createProcess();
+    if(PID == 0){
+        simOut() << "error: process slot is in use" << '\n';
+        return;
+    }
+
+    //   - allocate new variables for the <TEXT>, <GLOBALS>, and <STACK>
+    allocateVariable(PID, "<TEXT>", DataType::Char, text_size, mmu, page_table, page_size);
+    allocateVariable(PID, "<GLOBALS>", DataType::Char, data_size, mmu, page_table, page_size);
+    allocateVariable(PID, "<STACK>", DataType::Char, 65536, mmu, page_table, page_size);
+
+    //   - print pid
+    simOut() << PID << '\n';
+}
+
+void forkProcess(uint32_t pid, Mmu *mmu, PageTable *page_table)
+{
+    if(mmu->isProcessInMMU(pid) == 0){
+        simOut() << "error: process not found" << '\n';
+        return;
+    }
+    if(swap_enabled){
+        simOut() << "error: fork is not supported with swap enabled" << '\n';
+        return;
+    }
+
+    // The child's variables count towards memory like any others, even though
+    // their pages stay shared with the parent until either side writes to them
+    uint32_t child = mmu->forkProcess(pid);
+    if(child == 0){
+        simOut() << "error: process slot is in use" << '\n';
+        return;
+    }
+    Process *p = mmu->getProcessAt(child);
+    std::map<uint32_t, Variable*>::iterator it;
+    for(it = p->variables.begin(); it != p->variables.end(); it++){
+        mem_utilization += it->second->size;
+    }
+
+    page_table->forkProcess(pid, child);
+    simOut() << child << '\n';
+}
+
+void allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table, int page_size)
+{
+    STAT_TIMER(StatAllocateVariable);
+    // TODO: implement this!
+    if(mmu->isProcessInMMU(pid) == 0){
+        simOut() << "error: process not found" << '\n';
+        return;
+	}
+
+    if(mmu->getVariableAt(pid, var_name) != NULL){
+        simOut() << "error: variable already exists" << '\n';
+        return;
+    }
+
+    uint32_t req_size = getTypeByteSize(type) * num_elements;
+    if(req_size == 0){
+        simOut() << "error: allocation size must be positive" << '\n';
+        return;
+    }
+
+    // Reserve the bytes before checking so concurrent shards cannot overshoot together.
+    // With swap enabled physical memory may be overcommitted
+    int64_t previous = mem_utilization.fetch_add(req_size);
+    if(!swap_enabled && previous + req_size > memory_size){
+        mem_utilization -= req_size;
+        simOut() << "error: allocation exceeds memory size. \n";
+        return;
+    }
+
+    //   - find free space in the process's heap according to the heap policy
+    Process *p = mmu->getProcessAt(pid);
+    uint32_t prev_addr; //this is the address we will be allocating the variable to.
+    if(!p->heap->allocate(req_size, &prev_addr)){
+        mem_utilization -= req_size;
+        simOut() << "error: allocation exceeds virtual address space" << '\n';
+        return;
+    }
+
+    //   - map every page the variable spans that isn't mapped yet and count its bytes there;
+    //     an aligned run of pages lying wholly inside the variable gets one large page
+    uint32_t large_factor = page_table->largePageFactor();
+    for(uint32_t page = prev_addr / page_size; page <= (prev_addr + req_size - 1) / page_size; page++){
+        if(!page_table->isMapped(pid, page)){
+            bool whole_run = large_factor > 1 && page % large_factor == 0 && page * page_size >= prev_addr
+                          && (uint64_t)(page + large_factor) * page_size <= (uint64_t)prev_addr + req_size;
+            if(!whole_run || !page_table->addLargeEntry(pid, page)){
+                page_table->addEntry(pid, page);
+            }
+            if(!page_table->isMapped(pid, page)){
+                // addEntry has reported it; undo the pages counted so far and the reservation
+                checkAndFreePage(pid, prev_addr, std::max(prev_addr, page * page_size) - prev_addr, page_table, page_size);
+                p->heap->release(prev_addr, req_size);
+                mem_utilization -= req_size;
+                return;
+            }
+        }
+        uint32_t start = std::max(prev_addr, page * page_size);
+        uint32_t end = std::min(prev_addr + req_size, (page + 1) * page_size);
+        page_table->addLiveBytes(pid, page, end - start);
+    }
+
+    mmu->addVariableToProcess(pid, var_name, type, req_size, prev_addr);
+
+    //   - print virtual memory address
+    if(var_name != "<TEXT>" && var_name != "<GLOBALS>" && var_name != "<STACK>")
+        simOut() << prev_addr << '\n';
+
+}
+
+void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *values, uint32_t num_values, Mmu *mmu, PageTable *page_table, void *memory, int page_size)
+{ 
+    Process *p = mmu->getProcessAt(pid);
+
+    if (p == NULL) {
+        simOut() << "error: process not found" << '\n';
+    } else { //   - look up physical address for variable based on its virtual address / offset
+        Variable *var = mmu->getVariableAt(pid, var_name);
+        if (var == NULL) {
+            simOut() << "error: variable not found" << '\n';
+        } else {
+            writeVariable(pid, var, offset, values, num_values, page_table, memory, page_size);
+        }
+    }
+}
+
+void writeVariable(uint32_t pid, Variable *var, uint32_t offset, void *values, uint32_t num_values, PageTable *page_table, void *memory, int page_size)
+{
+    STAT_TIMER(StatWriteVariable);
+    // `values` holds num_values consecutive elements of the variable's type
+    uint32_t type_size = getTypeByteSize(var->type);
+    if (((uint64_t)offset + num_values) * type_size > var->size) {
+        simOut() << "error: index out of range" << '\n';
+        return;
+    }
+
+    //   - insert `values` into `memory`, translating once per page touched
+    copyToVirtual(pid, var->virtual_address + (offset * type_size), values, num_values * type_size, page_table, memory, page_size);
+}
+
+bool readVariable(uint32_t pid, Variable *var, uint32_t offset, void *values, uint32_t num_values, PageTable *page_table, void *memory, int page_size)
+{
+    // Fills `values` with num_values consecutive elements, translating once per page touched
+    uint32_t type_size = getTypeByteSize(var->type);
+    if (((uint64_t)offset + num_values) * type_size > var->size) {
+        simOut() << "error: index out of range" << '\n';
+        return false;
+    }
+
+    return copyFromVirtual(pid, var->virtual_address + (offset * type_size), values, num_values * type_size, page_table, memory, page_size);
+}
+
+template <typename T>
+static void printValues(const T *values, uint32_t count, uint32_t numvars)
+{
+    for(uint32_t i = 0; i < count; i++){
+        simOut() << values[i];
+        if(i < 3 || i < numvars - 1){
+            simOut() << ", ";
+        }
+    }
+}
+
+void printVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, void *memory, int page_size)
+{
+    STAT_TIMER(StatPrintVariable);
+    //print the value of the variable indicated by the request
+    Variable *inq = mmu->getVariableAt(pid, var_name);
+    if(inq == NULL){
+        simOut() << "error: variable not found\n";
+        return;
+    }
+
+    int offset_inc = getTypeByteSize(inq->type);
+    simOut() << var_name << '\n';
+
+    uint32_t numvars = inq->size / offset_inc; //how many values are in this variable?
+
+    //only the first five values are shown, so fetch exactly those in one bulk read; pages may fault back in here
+    uint32_t shown = std::min(numvars, 5u);
+    uint64_t values[5] = {0, 0, 0, 0, 0};
+    readVariable(pid, inq, 0, values, shown, page_table, memory, page_size);
+
+    if(inq->type == Char) {
+        printValues((char*)values, shown, numvars);
+    } else if(inq->type == Short) {
+        printValues((short*)values, shown, numvars);
+    } else if(inq->type == Int) {
+        printValues((int*)values, shown, numvars);
+    } else if(inq->type == Float) {
+        printValues((float*)values, shown, numvars);
+    } else if(inq->type == Long) {
+        printValues((long*)values, shown, numvars);
+    } else if(inq->type == Double) {
+        printValues((double*)values, shown, numvars);
+    }
+
+    if(numvars > 4){
+        simOut()  << "...[" << numvars << " items]" << '\n';      
+    } else {
+        simOut() << '\n';        
+    }
+}
+
+void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table, int page_size)
+{
+    STAT_TIMER(StatFreeVariable);
+    // TODO: implement this!
+    if(mmu->isProcessInMMU(pid) == 0){
+        simOut() << "error: process not found" << '\n';
+        return;
+	}
+    
+    //   - remove entry from MMU
+    Variable *toRemove = mmu->getVariableAt(pid, var_name);
+    if(toRemove == NULL){
+        simOut() << "error: variable not found" << '\n';
+        return;
+    }
+    uint32_t address = toRemove->virtual_address;
+    uint32_t size = toRemove->size;
+    mem_utilization -= size;
+
+    //return the space to the heap, merging it with free space neighbors.
+    mmu->checkAndMerge(pid, toRemove);
+
+    //   - free page if this variable was the only one on a given page
+    checkAndFreePage(pid, address, size, page_table, page_size);
+}
+
+void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table, int page_size)
+{
+    STAT_TIMER(StatTerminateProcess);
+    if(mmu->isProcessInMMU(pid) == 0){
+        simOut() << "error: process not found" << '\n';
+        return;
+	}
+
+    // Everything the process owns goes at once: its pages and frames in one
+    // pass over its page table, then its variables and heap with the process
+    Process *toKill = mmu->getProcessAt(pid);
+    std::map<uint32_t, Variable*>::iterator it;
+    for(it = toKill->variables.begin(); it != toKill->variables.end(); it++){
+        mem_utilization -= it->second->size;
+	}
+
+    page_table->removeProcess(pid);
+    mmu->killProcess(pid);
+}
+
+int getTypeByteSize(DataType type){
+    if(type == FreeSpace){ //set offset incrementer based on datatype.
+            return 1;
+	} else if(type == Char) {
+            return 1;
+    } else if(type == Short) {
+            return 2;
+    } else if(type == Int) {
+            return 4;
+    } else if(type == Float) {
+            return 4;
+    } else if(type == Long) {
+            return 8;
+    } else if(type == Double) {
+            return 8;
+    } else {
+            simOut() << "error: incorrect type passed to getTypeByteSize" << '\n';
+            return -1;
+    }
+}
+
+void checkAndFreePage(uint32_t pid, uint32_t address, uint32_t size, PageTable *page_table, int page_size){
+    STAT_TIMER(StatCheckAndFreePage);
+    if(size == 0){
+        return;
+    }
+
+    // Take the freed bytes off each page's live count; a page is released
+    // as soon as nothing is left on it
+    for(uint32_t page = address / page_size; page <= (address + size - 1) / page_size; page++){
+        uint32_t start = std::max(address, page * page_size);
+        uint32_t end = std::min(address + size, (page + 1) * page_size);
+        page_table->removeLiveBytes(pid, page, end - start);
+    }
+}
+
+bool copyToVirtual(uint32_t pid, uint32_t virtual_address, const void *data, uint32_t size, PageTable *page_table, void *memory, int page_size){
+    // Split the copy at page boundaries since neighbouring pages need not share a frame
+    const char *src = (const char*)data;
+    CacheHierarchy *cache = page_table->cache();
+    WorkingSetAnalyzer *analyzer = page_table->analyzer();
+    if(page_table->sweep() != NULL && size > 0){
+        page_table->sweep()->access(pid, virtual_address, size);
+    }
+    while(size > 0){
+        uint32_t chunk = std::min(size, page_size - (virtual_address % page_size));
+        int64_t physical_address = page_table->getWritableAddress(pid, virtual_address, memory);
+        if(physical_address == -1){
+            return false;
+        }
+        if(cache != NULL){
+            cache->access(pid, physical_address, chunk, true);
+        }
+        if(analyzer != NULL){
+            analyzer->access(pid, virtual_address, chunk);
+        }
+        memcpy((char*)memory + physical_address, src, chunk);
+        virtual_address += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool copyFromVirtual(uint32_t pid, uint32_t virtual_address, void *data, uint32_t size, PageTable *page_table, void *memory, int page_size){
+    char *dst = (char*)data;
+    CacheHierarchy *cache = page_table->cache();
+    WorkingSetAnalyzer *analyzer = page_table->analyzer();
+    if(page_table->sweep() != NULL && size > 0){
+        page_table->sweep()->access(pid, virtual_address, size);
+    }
+    while(size > 0){
+        uint32_t chunk = std::min(size, page_size - (virtual_address % page_size));
+        int64_t physical_address = page_table->getPhysicalAddress(pid, virtual_address);
+        if(physical_address == -1){
+            return false;
+        }
+        if(cache != NULL){
+            cache->access(pid, physical_address, chunk, false);
+        }
+        if(analyzer != NULL){
+            analyzer->access(pid, virtual_address, chunk);
+        }
+        memcpy(dst, (char*)memory + physical_address, chunk);
+        virtual_address += chunk;
+        dst += chunk;
+        size -= chunk;
+    }
+    return true;
+}
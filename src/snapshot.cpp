@@ -0,0 +1,278 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "simulator.h"
+#include "output.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static uint64_t hashBytes(uint64_t hash, const void *data, uint64_t length)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (uint64_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+SnapshotWriter::SnapshotWriter(std::string path)
+{
+    _length = 0;
+    _hash = FNV_OFFSET;
+    _file = fopen(path.c_str(), "wb");
+    if (_file != NULL)
+    {
+        // The header is rewritten by finish() once the payload is known
+        setvbuf(_file, NULL, _IOFBF, 1 << 20);
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        fwrite(&header, sizeof(header), 1, _file);
+    }
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+    }
+}
+
+bool SnapshotWriter::isOpen()
+{
+    return _file != NULL;
+}
+
+void SnapshotWriter::put8(uint8_t value)
+{
+    putBytes(&value, sizeof(value));
+}
+
+void SnapshotWriter::put32(uint32_t value)
+{
+    putBytes(&value, sizeof(value));
+}
+
+void SnapshotWriter::put64(uint64_t value)
+{
+    putBytes(&value, sizeof(value));
+}
+
+void SnapshotWriter::putBytes(const void *data, uint32_t length)
+{
+    fwrite(data, 1, length, _file);
+    _hash = hashBytes(_hash, data, length);
+    _length += length;
+}
+
+void SnapshotWriter::putString(const std::string &text)
+{
+    put32(text.size());
+    putBytes(text.data(), text.size());
+}
+
+bool SnapshotWriter::finish(uint32_t page_size, uint32_t large_factor)
+{
+    SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, page_size, large_factor, _length, _hash};
+    bool written = fseek(_file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, _file) == 1;
+    written = (fclose(_file) == 0) && written;
+    _file = NULL;
+    return written;
+}
+
+SnapshotReader::SnapshotReader()
+{
+    _map = NULL;
+    _map_size = 0;
+    _data = NULL;
+    _size = 0;
+    _position = 0;
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    if (_map != NULL)
+    {
+        munmap((void*)_map, _map_size);
+    }
+}
+
+bool SnapshotReader::open(std::string path, uint32_t page_size, uint32_t large_factor)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        simOut() << "error: could not open snapshot " << path << '\n';
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    if (info.st_size < sizeof(SnapshotHeader))
+    {
+        close(fd);
+        simOut() << "error: " << path << " is not a snapshot\n";
+        return false;
+    }
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        simOut() << "error: could not map snapshot " << path << '\n';
+        return false;
+    }
+    madvise(map, info.st_size, MADV_SEQUENTIAL);
+    _map = (const char*)map;
+    _map_size = info.st_size;
+
+    SnapshotHeader header;
+    memcpy(&header, _map, sizeof(header));
+    _data = _map + sizeof(header);
+    _size = _map_size - sizeof(header);
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION)
+    {
+        simOut() << "error: " << path << " is not a snapshot\n";
+        return false;
+    }
+    if (header.length != _size || hashBytes(FNV_OFFSET, _data, _size) != header.hash)
+    {
+        simOut() << "error: snapshot " << path << " is corrupt\n";
+        return false;
+    }
+    if (header.page_size != page_size)
+    {
+        simOut() << "error: snapshot " << path << " was taken with a page size of " << header.page_size << '\n';
+        return false;
+    }
+    if (header.large_factor != large_factor)
+    {
+        if (header.large_factor > 1) {
+            simOut() << "error: snapshot " << path << " was taken with large pages of " << header.large_factor * header.page_size << " bytes\n";
+        } else {
+            simOut() << "error: snapshot " << path << " was taken without large pages\n";
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotReader::get8(uint8_t *value)
+{
+    const char *bytes = getBytes(sizeof(*value));
+    if (bytes == NULL)
+    {
+        return false;
+    }
+    *value = *bytes;
+    return true;
+}
+
+bool SnapshotReader::get32(uint32_t *value)
+{
+    const char *bytes = getBytes(sizeof(*value));
+    if (bytes == NULL)
+    {
+        return false;
+    }
+    memcpy(value, bytes, sizeof(*value));
+    return true;
+}
+
+bool SnapshotReader::get64(uint64_t *value)
+{
+    const char *bytes = getBytes(sizeof(*value));
+    if (bytes == NULL)
+    {
+        return false;
+    }
+    memcpy(value, bytes, sizeof(*value));
+    return true;
+}
+
+// Returns the next `length` bytes of the payload, or NULL if it is too short
+const char* SnapshotReader::getBytes(uint64_t length)
+{
+    if (_position + length > _size)
+    {
+        return NULL;
+    }
+    const char *bytes = _data + _position;
+    _position += length;
+    return bytes;
+}
+
+bool SnapshotReader::getString(std::string *text)
+{
+    uint32_t length;
+    const char *bytes;
+    if (!get32(&length) || (bytes = getBytes(length)) == NULL)
+    {
+        return false;
+    }
+    text->assign(bytes, length);
+    return true;
+}
+
+bool saveSnapshot(std::string path, Simulator *sim)
+{
+    if (sim->swap != NULL)
+    {
+        simOut() << "error: snapshots are not supported with swap enabled\n";
+        return false;
+    }
+    if (sim->mmu->isSharded())
+    {
+        simOut() << "error: snapshots are not supported with --threads\n";
+        return false;
+    }
+
+    SnapshotWriter writer(path);
+    if (!writer.isOpen())
+    {
+        simOut() << "error: could not write snapshot " << path << '\n';
+        return false;
+    }
+    sim->mmu->save(writer);
+    sim->page_table->save(writer, sim->memory);
+    if (!writer.finish(sim->page_size, sim->page_table->largePageFactor()))
+    {
+        simOut() << "error: could not write snapshot " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool restoreSnapshot(std::string path, Simulator *sim)
+{
+    if (sim->swap != NULL)
+    {
+        simOut() << "error: snapshots are not supported with swap enabled\n";
+        return false;
+    }
+    if (sim->mmu->isSharded())
+    {
+        simOut() << "error: snapshots are not supported with --threads\n";
+        return false;
+    }
+
+    SnapshotReader reader;
+    if (!reader.open(path, sim->page_size, sim->page_table->largePageFactor()))
+    {
+        return false;
+    }
+
+    // The current state is dropped wholesale, then rebuilt from the snapshot
+    uint64_t variable_bytes;
+    sim->page_table->clear();
+    if (!sim->mmu->load(reader, &variable_bytes) || !sim->page_table->load(reader, sim->memory))
+    {
+        simOut() << "error: snapshot " << path << " is corrupt\n";
+        return false;
+    }
+    mem_utilization = variable_bytes;
+    return true;
+}
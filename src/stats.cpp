@@ -0,0 +1,132 @@
+#include <iomanip>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include "stats.h"
+#include "mmu.h"
+#include "pagetable.h"
+
+typedef struct StatTable {
+    LatencyHistogram operations[STAT_NUM_OPERATIONS];
+} StatTable;
+
+static const char *operation_names[] = {"createProcess", "allocateVariable", "writeVariable", "printVariable", "freeVariable",
+                                        "terminateProcess", "PageTable::addEntry", "getPhysicalAddress", "checkAndMerge", "checkAndFreePage"};
+
+// Each thread records into its own table; tables stay registered after the
+// thread exits so printStats can merge them
+static std::mutex registry_lock;
+static std::vector<std::unique_ptr<StatTable> > registry;
+static thread_local StatTable *local_table = NULL;
+
+// Reference points for converting ticks to nanoseconds
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+static const uint64_t start_ticks = statTicks();
+
+void statRecord(StatOperation operation, uint64_t ticks)
+{
+    if (local_table == NULL)
+    {
+        local_table = new StatTable();
+        std::lock_guard<std::mutex> guard(registry_lock);
+        registry.push_back(std::unique_ptr<StatTable>(local_table));
+    }
+
+    LatencyHistogram &histogram = local_table->operations[operation];
+    int bucket = (ticks == 0) ? 0 : 64 - __builtin_clzll(ticks);
+    histogram.buckets[std::min(bucket, STAT_NUM_BUCKETS - 1)]++;
+    histogram.count++;
+    histogram.total_ticks += ticks;
+    histogram.max_ticks = std::max(histogram.max_ticks, ticks);
+}
+
+// Upper bound of the bucket holding the given fraction of samples
+static uint64_t percentileTicks(LatencyHistogram &histogram, double fraction)
+{
+    uint64_t target = (uint64_t)(histogram.count * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i < STAT_NUM_BUCKETS; i++)
+    {
+        seen += histogram.buckets[i];
+        if (seen > target)
+        {
+            return (i == 0) ? 0 : std::min((1ULL << i) - 1, (unsigned long long)histogram.max_ticks);
+        }
+    }
+    return histogram.max_ticks;
+}
+
+void printStats(std::ostream &out, Mmu *mmu, PageTable *page_table)
+{
+    printLatencyStats(out);
+    printMachineStats(out, mmu, page_table);
+}
+
+void printLatencyStats(std::ostream &out)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    double ns_per_tick = seconds * 1e9 / (double)(statTicks() - start_ticks);
+
+#ifdef MEMSIM_STATS
+    LatencyHistogram totals[STAT_NUM_OPERATIONS] = {};
+    {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        for (int t = 0; t < registry.size(); t++)
+        {
+            for (int op = 0; op < STAT_NUM_OPERATIONS; op++)
+            {
+                LatencyHistogram &from = registry[t]->operations[op];
+                totals[op].count += from.count;
+                totals[op].total_ticks += from.total_ticks;
+                totals[op].max_ticks = std::max(totals[op].max_ticks, from.max_ticks);
+                for (int b = 0; b < STAT_NUM_BUCKETS; b++)
+                {
+                    totals[op].buckets[b] += from.buckets[b];
+                }
+            }
+        }
+    }
+
+    uint64_t operations = 0;
+    out << "Operation            |      Count |    Ops/s    |  Mean (ns) |   p50 (ns) |   p99 (ns) |   Max (ns)" << '\n';
+    out << "---------------------+------------+-------------+------------+------------+------------+-----------" << '\n';
+    for (int op = 0; op < STAT_NUM_OPERATIONS; op++)
+    {
+        LatencyHistogram &h = totals[op];
+        if (op <= StatTerminateProcess)
+        {
+            operations += h.count;
+        }
+        if (h.count == 0)
+        {
+            continue;
+        }
+        out << std::left << std::setw(20) << operation_names[op] << std::right << " | " << std::setw(10) << h.count << " | "
+            << std::setw(11) << (uint64_t)(h.count / seconds) << " | "
+            << std::setw(10) << (uint64_t)(h.total_ticks * ns_per_tick / h.count) << " | "
+            << std::setw(10) << (uint64_t)(percentileTicks(h, 0.5) * ns_per_tick) << " | "
+            << std::setw(10) << (uint64_t)(percentileTicks(h, 0.99) * ns_per_tick) << " | "
+            << std::setw(10) << (uint64_t)(h.max_ticks * ns_per_tick) << '\n';
+    }
+    out << "Simulator operations: " << operations << " in " << std::fixed << std::setprecision(3) << seconds << " s ("
+        << std::setprecision(0) << operations / seconds << " operations/s)" << '\n';
+    out.unsetf(std::ios::floatfield);
+    out.precision(6);
+#else
+    out << "Latency histograms compiled out (build with make STATS=1)" << '\n';
+    out << "Uptime: " << seconds << " s" << '\n';
+#endif
+}
+
+void printMachineStats(std::ostream &out, Mmu *mmu, PageTable *page_table)
+{
+    HeapStats heap;
+    mmu->getHeapTotals(&heap);
+    out << "Page faults: " << page_table->pageFaults() << ", frames in use: " << page_table->framesInUse()
+        << " / " << page_table->numFrames() << '\n';
+    out << "Shared frames: " << page_table->sharedFrames() << ", copy-on-write faults: " << page_table->cowFaults() << '\n';
+    out << "Free-space fragments: " << heap.free_blocks << " (" << heap.holes << " holes, " << heap.hole_bytes
+        << " bytes), merges: " << heap.merges << '\n';
+}
@@ -0,0 +1,61 @@
+#include "swapfile.h"
+
+SwapFile::SwapFile(std::string path, int page_size)
+{
+    _path = path;
+    _page_size = page_size;
+    _num_slots = 0;
+    _file = fopen(path.c_str(), "w+b");
+}
+
+SwapFile::~SwapFile()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+        remove(_path.c_str());
+    }
+}
+
+bool SwapFile::isOpen()
+{
+    return _file != NULL;
+}
+
+int SwapFile::writePage(const void *data)
+{
+    // Reuse a released slot before growing the file
+    int slot;
+    if (_free_slots.size() > 0)
+    {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+    }
+    else
+    {
+        slot = _num_slots++;
+    }
+
+    fseeko(_file, (off_t)slot * _page_size, SEEK_SET);
+    fwrite(data, 1, _page_size, _file);
+    return slot;
+}
+
+void SwapFile::readPage(int slot, void *data)
+{
+    fseeko(_file, (off_t)slot * _page_size, SEEK_SET);
+    if (fread(data, 1, _page_size, _file) != _page_size)
+    {
+        fprintf(stderr, "error: short read from swap slot %d\n", slot);
+    }
+}
+
+void SwapFile::release(int slot)
+{
+    _free_slots.push_back(slot);
+}
+
+int SwapFile::slotsInUse()
+{
+    return _num_slots - _free_slots.size();
+}
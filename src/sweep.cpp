@@ -0,0 +1,168 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include "sweep.h"
+
+PageSweep::PageSweep(const std::vector<uint32_t> &page_sizes)
+{
+    _configs.resize(page_sizes.size());
+    for (int i = 0; i < page_sizes.size(); i++)
+    {
+        SweepConfig &config = _configs[i];
+        config.page_bits = __builtin_ctz(page_sizes[i]);
+        config.references = 0;
+        config.cold = 0;
+        std::fill(config.histogram, config.histogram + REUSE_BUCKETS, 0);
+    }
+    _accesses = 0;
+}
+
+bool PageSweep::parseSizes(std::string list, std::vector<uint32_t> *page_sizes)
+{
+    page_sizes->clear();
+    const char *text = list.c_str();
+    while (true)
+    {
+        char *end;
+        unsigned long size = strtoul(text, &end, 10);
+        if (end == text)
+        {
+            return false;
+        }
+        if (*end == 'K' || *end == 'k') {
+            size <<= 10;
+            end++;
+        } else if (*end == 'M' || *end == 'm') {
+            size <<= 20;
+            end++;
+        }
+        if (size == 0 || size > (1ul << 30) || (size & (size - 1)) != 0)
+        {
+            return false;
+        }
+        page_sizes->push_back(size);
+        if (*end == '\0')
+        {
+            break;
+        }
+        if (*end != ',')
+        {
+            return false;
+        }
+        text = end + 1;
+    }
+    std::sort(page_sizes->begin(), page_sizes->end());
+    page_sizes->erase(std::unique(page_sizes->begin(), page_sizes->end()), page_sizes->end());
+    return true;
+}
+
+// Takes a whole access, since every page size splits it differently
+void PageSweep::access(uint32_t pid, uint32_t virtual_address, uint32_t size)
+{
+    _accesses++;
+    uint32_t end = virtual_address + size - 1;
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        SweepConfig &config = _configs[i];
+        for (uint32_t page = virtual_address >> config.page_bits; page <= end >> config.page_bits; page++)
+        {
+            uint64_t distance = config.stack.access((uint64_t)pid << 32 | page);
+            config.references++;
+            if (distance == REUSE_COLD) {
+                config.cold++;
+                config.pages[pid].push_back(page);
+            } else {
+                config.histogram[(distance == 0) ? 0 : 64 - __builtin_clzll(distance)]++;
+            }
+        }
+    }
+}
+
+// A terminated process's pages leave the stack, freeing their frames for
+// everyone below them
+void PageSweep::processExited(uint32_t pid)
+{
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        SweepConfig &config = _configs[i];
+        std::unordered_map<uint32_t, std::vector<uint32_t> >::iterator it = config.pages.find(pid);
+        if (it == config.pages.end())
+        {
+            continue;
+        }
+        for (int p = 0; p < it->second.size(); p++)
+        {
+            config.stack.remove((uint64_t)pid << 32 | it->second[p]);
+        }
+        config.pages.erase(it);
+    }
+}
+
+void PageSweep::print()
+{
+    // Rows run from the smallest page up to the memory at which every page
+    // size is down to its first touches
+    int min_bits = _configs[0].page_bits;
+    int max_bits = min_bits;
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        for (int b = 0; b < REUSE_BUCKETS; b++)
+        {
+            if (_configs[i].histogram[b] > 0)
+            {
+                max_bits = std::max(max_bits, (int)_configs[i].page_bits + b);
+            }
+        }
+    }
+
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Sweep: LRU over all processes, " << _accesses << " accesses" << '\n';
+    std::cout << "Fault rate per reference, by page size (columns) and memory size in bytes (rows)" << '\n';
+    std::cout << "  Page size";
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        std::cout << " | " << std::setw(10) << (1u << _configs[i].page_bits);
+    }
+    std::cout << '\n' << " References";
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        std::cout << " | " << std::setw(10) << _configs[i].references;
+    }
+    std::cout << '\n' << "First touch";
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        std::cout << " | " << std::setw(10) << _configs[i].cold;
+    }
+    std::cout << '\n' << "-----------";
+    for (int i = 0; i < _configs.size(); i++)
+    {
+        std::cout << "-+-----------";
+    }
+    std::cout << '\n';
+
+    // Page faults per reference; a memory smaller than the page gets no entry
+    for (int bits = min_bits; bits <= max_bits && _accesses > 0; bits++)
+    {
+        std::cout << std::setw(11) << (1ULL << bits);
+        for (int i = 0; i < _configs.size(); i++)
+        {
+            SweepConfig &config = _configs[i];
+            if (bits < config.page_bits)
+            {
+                std::cout << " | " << std::setw(10) << "-";
+                continue;
+            }
+            uint64_t hits = 0;
+            for (int b = 0; b <= bits - (int)config.page_bits && b < REUSE_BUCKETS; b++)
+            {
+                hits += config.histogram[b];
+            }
+            std::cout << " | " << std::setw(9) << 100.0 * (config.references - hits) / config.references << "%";
+        }
+        std::cout << '\n';
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
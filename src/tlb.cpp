@@ -0,0 +1,201 @@
+#include <iomanip>
+#include "tlb.h"
+
+Tlb::Tlb(uint32_t num_entries, uint32_t ways, TlbPolicy policy)
+{
+    if (ways == 0 || ways > num_entries)
+    {
+        ways = num_entries; // fully associative
+    }
+    _ways = ways;
+    _num_sets = num_entries / ways;
+    _policy = policy;
+    _clock = 0;
+    _rand_state = 2463534242u;
+    _hits = 0;
+    _misses = 0;
+    _flushes = 0;
+
+    TlbEntry empty = {false, 0, 0, -1, 0};
+    _entries.assign(_num_sets * _ways, empty);
+}
+
+Tlb::~Tlb()
+{
+}
+
+bool Tlb::parsePolicy(std::string name, TlbPolicy *policy)
+{
+    if (name == "lru") {
+        *policy = TlbLru;
+    } else if (name == "fifo") {
+        *policy = TlbFifo;
+    } else if (name == "random") {
+        *policy = TlbRandom;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+TlbEntry* Tlb::set(uint32_t pid, uint32_t page_number)
+{
+    // Mix in the pid so equal page numbers of different processes spread out
+    uint32_t index = (page_number ^ (pid * 2654435761u)) % _num_sets;
+    return &_entries[index * _ways];
+}
+
+uint32_t Tlb::nextRandom()
+{
+    // xorshift32
+    _rand_state ^= _rand_state << 13;
+    _rand_state ^= _rand_state >> 17;
+    _rand_state ^= _rand_state << 5;
+    return _rand_state;
+}
+
+TlbEntry* Tlb::find(uint32_t pid, uint32_t page_number)
+{
+    TlbEntry *ways = set(pid, page_number);
+    _clock++;
+    for (int i = 0; i < _ways; i++)
+    {
+        if (ways[i].valid && ways[i].pid == pid && ways[i].page_number == page_number)
+        {
+            if (_policy == TlbLru)
+            {
+                ways[i].stamp = _clock;
+            }
+            return &ways[i];
+        }
+    }
+    return NULL;
+}
+
+int Tlb::lookup(uint32_t pid, uint32_t page_number)
+{
+    TlbEntry *entry = find(pid, page_number);
+    if (entry == NULL)
+    {
+        _misses++;
+        return -1;
+    }
+    _hits++;
+    return entry->frame;
+}
+
+// Probes for a large page entry and a base page entry together, counting a
+// single hit or miss as a TLB holding both sizes would
+int Tlb::lookupMixed(uint32_t pid, uint32_t page_number, uint32_t large_number, bool *large)
+{
+    TlbEntry *entry = find(pid, TLB_LARGE_PAGE | large_number);
+    *large = (entry != NULL);
+    if (entry == NULL)
+    {
+        entry = find(pid, page_number);
+    }
+    if (entry == NULL)
+    {
+        _misses++;
+        return -1;
+    }
+    _hits++;
+    return entry->frame;
+}
+
+void Tlb::insert(uint32_t pid, uint32_t page_number, int frame)
+{
+    TlbEntry *ways = set(pid, page_number);
+    TlbEntry *victim = NULL;
+
+    // Prefer an empty way, otherwise evict according to the policy
+    for (int i = 0; i < _ways && victim == NULL; i++)
+    {
+        if (!ways[i].valid)
+        {
+            victim = &ways[i];
+        }
+    }
+    if (victim == NULL)
+    {
+        if (_policy == TlbRandom)
+        {
+            victim = &ways[nextRandom() % _ways];
+        }
+        else
+        {
+            victim = &ways[0];
+            for (int i = 1; i < _ways; i++)
+            {
+                if (ways[i].stamp < victim->stamp)
+                {
+                    victim = &ways[i];
+                }
+            }
+        }
+    }
+
+    victim->valid = true;
+    victim->pid = pid;
+    victim->page_number = page_number;
+    victim->frame = frame;
+    victim->stamp = ++_clock;
+}
+
+void Tlb::invalidate(uint32_t pid, uint32_t page_number)
+{
+    TlbEntry *ways = set(pid, page_number);
+    for (int i = 0; i < _ways; i++)
+    {
+        if (ways[i].valid && ways[i].pid == pid && ways[i].page_number == page_number)
+        {
+            ways[i].valid = false;
+        }
+    }
+}
+
+void Tlb::flushProcess(uint32_t pid)
+{
+    for (int i = 0; i < _entries.size(); i++)
+    {
+        if (_entries[i].pid == pid)
+        {
+            _entries[i].valid = false;
+        }
+    }
+    _flushes++;
+}
+
+void Tlb::countEntries(uint32_t *valid, uint32_t *large)
+{
+    *valid = 0;
+    *large = 0;
+    for (int i = 0; i < _entries.size(); i++)
+    {
+        if (_entries[i].valid)
+        {
+            (*valid)++;
+            if (_entries[i].page_number & TLB_LARGE_PAGE)
+            {
+                (*large)++;
+            }
+        }
+    }
+}
+
+void Tlb::print()
+{
+    const char *policies[] = {"lru", "fifo", "random"};
+    uint64_t lookups = _hits + _misses;
+    double hit_rate = (lookups > 0) ? (100.0 * _hits / lookups) : 0.0;
+
+    std::cout << "TLB: " << _num_sets * _ways << " entries, " << _ways << "-way, " << policies[_policy] << '\n';
+    std::cout << "  Lookups  | " << lookups << '\n';
+    std::cout << "  Hits     | " << _hits << '\n';
+    std::cout << "  Misses   | " << _misses << '\n';
+    std::streamsize precision = std::cout.precision();
+    std::cout << "  Hit rate | " << std::fixed << std::setprecision(2) << hit_rate << "%" << '\n';
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+    std::cout << "  Flushes  | " << _flushes << '\n';
+}
@@ -0,0 +1,364 @@
+#include <math.h>
+#include <stdlib.h>
+#include <cstring>
+#include <algorithm>
+#include "workload.h"
+
+// Command mix for a chosen process: allocations, then sets, the rest prints
+#define WORKLOAD_ALLOCATE_SHARE 0.3
+#define WORKLOAD_SET_SHARE 0.55
+#define WORKLOAD_RECENT_VARIABLES 4
+
+// Every process starts with <TEXT>, <GLOBALS> and a 64 KB <STACK>
+#define WORKLOAD_TEXT_SIZE 2048
+#define WORKLOAD_GLOBALS_SIZE 2048
+#define WORKLOAD_PROCESS_BYTES (WORKLOAD_TEXT_SIZE + WORKLOAD_GLOBALS_SIZE + 65536)
+
+static const char *type_names[] = {"freespace", "char", "short", "int", "float", "long", "double"};
+static const uint32_t type_sizes[] = {0, 1, 2, 4, 4, 8, 8};
+
+WorkloadGenerator::WorkloadGenerator(WorkloadConfig config)
+{
+    _config = config;
+    _state = config.seed * 0x9E3779B97F4A7C15ULL + 1;
+    _emitted = 0;
+    _next_variable = 0;
+    _live_bytes = 0;
+    _last_process = -1;
+
+    if (config.sizes == SizeZipf)
+    {
+        // P(k) is proportional to 1 / k^s over ranks 1..n
+        uint32_t ranks = config.max_elements - config.min_elements + 1;
+        double total = 0;
+        _zipf_cdf.resize(ranks);
+        for (uint32_t k = 0; k < ranks; k++)
+        {
+            total += 1.0 / pow(k + 1, config.zipf_exponent);
+            _zipf_cdf[k] = total;
+        }
+        for (uint32_t k = 0; k < ranks; k++)
+        {
+            _zipf_cdf[k] /= total;
+        }
+    }
+
+    _processes.resize(config.processes);
+    for (int i = 0; i < _processes.size(); i++)
+    {
+        createProcess(i);
+    }
+}
+
+void WorkloadGenerator::defaultConfig(WorkloadConfig *config)
+{
+    config->seed = 1;
+    config->operations = 1000000;
+    config->processes = 16;
+    config->sizes = SizeUniform;
+    config->min_elements = 1;
+    config->max_elements = 1024;
+    config->zipf_exponent = 1.0;
+    config->large_fraction = 0.1;
+    config->lifetime = 1000;
+    config->process_lifetime = 0;
+    config->locality = 0.5;
+    config->values = 8;
+    config->budget = 48 * 1024 * 1024;
+}
+
+bool WorkloadGenerator::parseSpec(std::string spec, WorkloadConfig *config)
+{
+    size_t start = 0;
+    while (start < spec.size())
+    {
+        size_t comma = spec.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = spec.size();
+        }
+        std::string pair = spec.substr(start, comma - start);
+        start = comma + 1;
+
+        size_t equals = pair.find('=');
+        if (equals == std::string::npos)
+        {
+            return false;
+        }
+        std::string key = pair.substr(0, equals);
+        const char *value = pair.c_str() + equals + 1;
+        char *end;
+        double number = strtod(value, &end);
+        bool numeric = (*value != '\0' && *end == '\0' && number >= 0);
+
+        if (key == "sizes") {
+            if (strcmp(value, "uniform") == 0) {
+                config->sizes = SizeUniform;
+            } else if (strcmp(value, "zipf") == 0) {
+                config->sizes = SizeZipf;
+            } else if (strcmp(value, "bimodal") == 0) {
+                config->sizes = SizeBimodal;
+            } else {
+                return false;
+            }
+        } else if (!numeric) {
+            return false;
+        } else if (key == "seed") {
+            config->seed = number;
+        } else if (key == "ops") {
+            config->operations = number;
+        } else if (key == "procs") {
+            config->processes = number;
+        } else if (key == "min") {
+            config->min_elements = number;
+        } else if (key == "max") {
+            config->max_elements = number;
+        } else if (key == "zipf") {
+            config->zipf_exponent = number;
+        } else if (key == "large") {
+            config->large_fraction = number;
+        } else if (key == "lifetime") {
+            config->lifetime = number;
+        } else if (key == "proc_lifetime") {
+            config->process_lifetime = number;
+        } else if (key == "locality") {
+            config->locality = number;
+        } else if (key == "values") {
+            config->values = number;
+        } else if (key == "budget") {
+            config->budget = number;
+        } else {
+            return false;
+        }
+    }
+
+    return config->processes > 0 && config->min_elements > 0 && config->max_elements >= config->min_elements
+        && config->locality <= 1.0 && config->large_fraction <= 1.0 && config->values > 0;
+}
+
+uint64_t WorkloadGenerator::random()
+{
+    // splitmix64: small state, good enough spread for workload shaping
+    uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double WorkloadGenerator::uniform()
+{
+    return (random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double WorkloadGenerator::exponential(double mean)
+{
+    return -mean * log(1.0 - uniform());
+}
+
+uint32_t WorkloadGenerator::sampleElements()
+{
+    uint32_t low = _config.min_elements;
+    uint32_t high = _config.max_elements;
+    if (_config.sizes == SizeZipf)
+    {
+        double u = uniform();
+        return low + (std::upper_bound(_zipf_cdf.begin(), _zipf_cdf.end(), u) - _zipf_cdf.begin());
+    }
+    if (_config.sizes == SizeBimodal)
+    {
+        // Mostly small objects from the bottom of the range, a few from the top quarter
+        if (uniform() < _config.large_fraction)
+        {
+            low = high - (high - low) / 4;
+        }
+        else
+        {
+            high = low + (high - low) / 16;
+        }
+    }
+    return low + random() % (high - low + 1);
+}
+
+void WorkloadGenerator::createProcess(int index)
+{
+    // Same slot reuse as Mmu::createProcess: last vacated slot first
+    uint32_t slot;
+    if (_free_slots.size() > 0)
+    {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+    }
+    else
+    {
+        slot = _generations.size();
+        _generations.push_back(0);
+    }
+
+    GenProcess &proc = _processes[index];
+    proc.pid = PID_BASE + ((_generations[slot] << PID_SLOT_BITS) | slot);
+    proc.deadline = (_config.process_lifetime > 0) ? _emitted + 1 + (uint64_t)exponential(_config.process_lifetime) : UINT64_MAX;
+    proc.variables.clear();
+    proc.recent.clear();
+    _live_bytes += WORKLOAD_PROCESS_BYTES;
+    _pending.push_back("create " + std::to_string(WORKLOAD_TEXT_SIZE) + " " + std::to_string(WORKLOAD_GLOBALS_SIZE));
+}
+
+void WorkloadGenerator::terminateProcess(int index)
+{
+    GenProcess &proc = _processes[index];
+    for (int i = 0; i < proc.variables.size(); i++)
+    {
+        GenVariable &var = _variables[proc.variables[i]];
+        _live_bytes -= var.count * type_sizes[var.type];
+        _variables.erase(proc.variables[i]);
+    }
+    _live_bytes -= WORKLOAD_PROCESS_BYTES;
+
+    uint32_t slot = (proc.pid - PID_BASE) & PID_SLOT_MASK;
+    _generations[slot] = (_generations[slot] + 1) & ((1u << (32 - PID_SLOT_BITS)) - 1);
+    _free_slots.push_back(slot);
+    _pending.push_back("terminate " + std::to_string(proc.pid));
+}
+
+void WorkloadGenerator::allocate(GenProcess &proc)
+{
+    DataType type = (DataType)(1 + random() % 6);
+    uint32_t count = sampleElements();
+
+    // Stay inside the memory budget by retiring this process's variables first
+    while (_live_bytes + (uint64_t)count * type_sizes[type] > _config.budget && !proc.variables.empty())
+    {
+        release(proc.variables[random() % proc.variables.size()]);
+    }
+    if (_live_bytes + (uint64_t)count * type_sizes[type] > _config.budget)
+    {
+        type = Char;
+        count = 1;
+    }
+
+    GenVariable var = {_next_variable++, (uint32_t)(&proc - &_processes[0]), (uint32_t)proc.variables.size(), type, count};
+    _variables[var.id] = var;
+    proc.variables.push_back(var.id);
+    proc.recent.push_front(var.id);
+    if (proc.recent.size() > WORKLOAD_RECENT_VARIABLES)
+    {
+        proc.recent.pop_back();
+    }
+    _live_bytes += (uint64_t)count * type_sizes[type];
+    if (_config.lifetime > 0)
+    {
+        _deaths.push(Death(_emitted + 1 + (uint64_t)exponential(_config.lifetime), var.id));
+    }
+
+    _pending.push_back("allocate " + std::to_string(proc.pid) + " v" + std::to_string(var.id) + " " + type_names[type] + " " + std::to_string(count));
+}
+
+void WorkloadGenerator::release(uint64_t id)
+{
+    GenVariable var = _variables[id];
+    _variables.erase(id);
+    _live_bytes -= var.count * type_sizes[var.type];
+
+    // Swap the last variable into the freed position
+    GenProcess &proc = _processes[var.process];
+    uint64_t moved = proc.variables.back();
+    proc.variables[var.position] = moved;
+    proc.variables.pop_back();
+    if (moved != id)
+    {
+        _variables[moved].position = var.position;
+    }
+
+    _pending.push_back("free " + std::to_string(proc.pid) + " v" + std::to_string(id));
+}
+
+void WorkloadGenerator::touch(GenProcess &proc)
+{
+    // Locality favours the variables this process used most recently
+    uint64_t id = proc.variables[random() % proc.variables.size()];
+    if (!proc.recent.empty() && uniform() < _config.locality)
+    {
+        uint64_t candidate = proc.recent[random() % proc.recent.size()];
+        if (_variables.count(candidate) > 0)
+        {
+            id = candidate;
+        }
+    }
+    GenVariable &var = _variables[id];
+
+    if (uniform() >= WORKLOAD_SET_SHARE / (1.0 - WORKLOAD_ALLOCATE_SHARE))
+    {
+        _pending.push_back("print " + std::to_string(proc.pid) + ":v" + std::to_string(id));
+        return;
+    }
+
+    uint32_t num_values = std::min(_config.values, var.count);
+    uint32_t offset = random() % (var.count - num_values + 1);
+    std::string line = "set " + std::to_string(proc.pid) + " v" + std::to_string(id) + " " + std::to_string(offset);
+    for (uint32_t i = 0; i < num_values; i++)
+    {
+        uint64_t r = random();
+        line += ' ';
+        if (var.type == Char) {
+            line += (char)('a' + r % 26);
+        } else if (var.type == Float || var.type == Double) {
+            line += std::to_string(r % 10000) + "." + std::to_string(r % 100);
+        } else if (var.type == Short) {
+            line += std::to_string(r % 32768);
+        } else {
+            line += std::to_string(r % 1000000);
+        }
+    }
+    _pending.push_back(line);
+}
+
+void WorkloadGenerator::step()
+{
+    // Variables whose lifetime ran out are freed before anything else happens
+    while (!_deaths.empty() && _deaths.top().first <= _emitted)
+    {
+        uint64_t id = _deaths.top().second;
+        _deaths.pop();
+        if (_variables.count(id) > 0)
+        {
+            release(id);
+            return;
+        }
+    }
+
+    int index = (_last_process >= 0 && uniform() < _config.locality) ? _last_process : random() % _processes.size();
+    _last_process = index;
+    GenProcess &proc = _processes[index];
+    if (proc.deadline <= _emitted)
+    {
+        terminateProcess(index);
+        createProcess(index);
+        return;
+    }
+
+    if (proc.variables.empty() || uniform() < WORKLOAD_ALLOCATE_SHARE)
+    {
+        allocate(proc);
+    }
+    else
+    {
+        touch(proc);
+    }
+}
+
+bool WorkloadGenerator::next(std::string &line)
+{
+    if (_emitted >= _config.operations)
+    {
+        return false;
+    }
+    while (_pending.empty())
+    {
+        step();
+    }
+
+    line.swap(_pending.front());
+    _pending.pop_front();
+    _emitted++;
+    return true;
+}